@@ -0,0 +1,497 @@
+/*
+LidarLiteBenchmark - Throughput and latency of the LidarLite read path
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Runs the driver against a LidarLiteSimulator so regressions show up on a dev
+machine before flashing devices. Benchmarks taking bus latency arguments run
+with a free bus (0, 0) and with roughly 100kHz I2C timing (50us per
+transaction, 90us per byte).
+
+	cmake -S . -B build && cmake --build build
+	./build/lidarlite_benchmark
+*/
+
+#include "LidarLite.hpp"
+#include "LidarLiteBusArbiter.hpp"
+#include "LidarLiteCorrelation.hpp"
+#include "LidarLiteReader.hpp"
+#include "LidarLiteScanner.hpp"
+#include "LidarLiteSharedMemory.hpp"
+#include "LidarLiteSimulatedActuator.hpp"
+#include "LidarLiteSimulator.hpp"
+#include "LidarLiteStatus.hpp"
+#include "LidarLiteStreamServer.hpp"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <sys/resource.h>
+
+// Short acquisitions keep the runs quick while still exercising the busy wait
+static const int ACQUISITION_MICROS = 500;
+
+//--------------------------------------------------------------
+static shared_ptr<LidarLiteSimulator> makeSimulator(int transactionMicros, int byteMicros) {
+	shared_ptr<LidarLiteSimulator> sim(new LidarLiteSimulator());
+	sim->addDevice(0x62);
+	sim->setTarget(0x62, 250, 120, 2);
+	sim->setAcquisitionTime(0x62, ACQUISITION_MICROS, 0);
+	sim->setBusLatency(transactionMicros, byteMicros);
+	return sim;
+}
+
+//--------------------------------------------------------------
+static void setUp(LidarLite & lidar, shared_ptr<LidarLiteSimulator> sim) {
+	lidar.setBus(sim);
+	lidar.begin(0);
+	lidar.setAcquisitionTime(ACQUISITION_MICROS, 0);
+}
+
+//--------------------------------------------------------------
+static void reportTransactions(benchmark::State & state, shared_ptr<LidarLiteSimulator> sim, unsigned long start) {
+	state.counters["transactions"] = benchmark::Counter(
+		(double) (sim->transactionCount() - start), benchmark::Counter::kAvgIterations);
+}
+
+//--------------------------------------------------------------
+static void BM_Distance(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator((int) state.range(0), (int) state.range(1));
+	LidarLite lidar;
+	setUp(lidar, sim);
+	unsigned long start = sim->transactionCount();
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(lidar.distance(false));
+	}
+	reportTransactions(state, sim, start);
+}
+BENCHMARK(BM_Distance)->Args({0, 0})->Args({50, 90})->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//--------------------------------------------------------------
+static void BM_DistanceAndSignalStrength(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator((int) state.range(0), (int) state.range(1));
+	LidarLite lidar;
+	setUp(lidar, sim);
+	unsigned long start = sim->transactionCount();
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(lidar.distance(false));
+		benchmark::DoNotOptimize(lidar.signalStrength());
+	}
+	reportTransactions(state, sim, start);
+}
+BENCHMARK(BM_DistanceAndSignalStrength)->Args({0, 0})->Args({50, 90})->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//--------------------------------------------------------------
+static void BM_Measure(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator((int) state.range(0), (int) state.range(1));
+	LidarLite lidar;
+	setUp(lidar, sim);
+	LidarLiteMeasurement m;
+	unsigned long start = sim->transactionCount();
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(lidar.measure(m, false));
+	}
+	reportTransactions(state, sim, start);
+}
+BENCHMARK(BM_Measure)->Args({0, 0})->Args({50, 90})->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+/* =============================================================================
+  BM_SustainedRate
+  Back to back measurements with range(1) us of host work per sample (the
+  filtering and hand-off a reader does), serial measure() for range(0) = 0 and
+  measurePipelined() for range(0) = 1, over a ~100kHz bus. The acquisition is
+  a more realistic 3ms here; pipelining hides the readout and host work behind
+  the next acquisition.
+============================================================================= */
+static void BM_SustainedRate(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator(50, 90);
+	sim->setAcquisitionTime(0x62, 3000, 0);
+	LidarLite lidar;
+	setUp(lidar, sim);
+	lidar.setAcquisitionTime(3000, 0);
+	bool pipelined = state.range(0) != 0;
+	std::chrono::microseconds work((int) state.range(1));
+	LidarLiteMeasurement m;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(pipelined ? lidar.measurePipelined(m, false) : lidar.measure(m, false));
+		std::chrono::steady_clock::time_point until = std::chrono::steady_clock::now() + work;
+		while (std::chrono::steady_clock::now() < until) {}
+	}
+	lidar.endPipeline();
+	state.counters["samples_per_s"] = benchmark::Counter((double) state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_SustainedRate)->Args({0, 0})->Args({1, 0})->Args({0, 1000})->Args({1, 1000})->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+/* =============================================================================
+  BM_MeasureStabilized
+  measure() with DC stabilization requested on every call, range(0) = 0 does
+  it every time, range(0) = 1 lets setAdaptiveStabilization() decide.
+  range(1) = 1 uses measurePipelined() instead, which should stabilize about
+  as often as measure(). The simulated DC correction takes 1500us on top of
+  the acquisition, and max noise drifts by 2 per uncorrected acquisition.
+  stabilized is the fraction of measurements that were stabilized.
+============================================================================= */
+static void BM_MeasureStabilized(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator(0, 0);
+	sim->setAcquisitionTime(0x62, ACQUISITION_MICROS, 1500);
+	sim->setNoiseDrift(0x62, 2);
+	LidarLite lidar;
+	setUp(lidar, sim);
+	lidar.setAcquisitionTime(ACQUISITION_MICROS, 1500);
+	lidar.setAdaptiveStabilization(state.range(0) != 0);
+	bool pipelined = state.range(1) != 0;
+	LidarLiteMeasurement m;
+	unsigned long start = lidar.stabilizationCount();
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(pipelined ? lidar.measurePipelined(m) : lidar.measure(m));
+	}
+	lidar.endPipeline();
+	state.counters["stabilized"] = benchmark::Counter(
+		(double) (lidar.stabilizationCount() - start), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_MeasureStabilized)->Args({0, 0})->Args({1, 0})->Args({1, 1})->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//--------------------------------------------------------------
+// measure() without (0) and with (1) LidarLiteStats attached, the difference is the instrumentation cost
+static void BM_MeasureStats(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator(0, 0);
+	LidarLite lidar;
+	setUp(lidar, sim);
+	if (state.range(0)) lidar.setStats(shared_ptr<LidarLiteStats>(new LidarLiteStats()));
+	LidarLiteMeasurement m;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(lidar.measure(m, false));
+	}
+}
+BENCHMARK(BM_MeasureStats)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+//--------------------------------------------------------------
+static void BM_SignalStrength(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator((int) state.range(0), (int) state.range(1));
+	LidarLite lidar;
+	setUp(lidar, sim);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(lidar.signalStrength());
+	}
+}
+BENCHMARK(BM_SignalStrength)->Args({0, 0})->Args({50, 90})->Unit(benchmark::kMicrosecond);
+
+//--------------------------------------------------------------
+static void BM_Status(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator((int) state.range(0), (int) state.range(1));
+	LidarLite lidar;
+	setUp(lidar, sim);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(lidar.status());
+	}
+}
+BENCHMARK(BM_Status)->Args({0, 0})->Args({50, 90})->Unit(benchmark::kMicrosecond);
+
+/* =============================================================================
+  BM_BusyWait
+  Time from trigger until the result is read, for an acquisition of
+  range(0) microseconds. overshoot_us is how long the busy wait takes beyond
+  the acquisition itself, polls counts status register reads per sample and
+  cpu time shows how much of the wait was spent spinning.
+============================================================================= */
+static void BM_BusyWait(benchmark::State & state) {
+	int acquisitionMicros = (int) state.range(0);
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator(0, 0);
+	sim->setAcquisitionTime(0x62, acquisitionMicros, 0);
+	LidarLite lidar;
+	setUp(lidar, sim);
+	lidar.setAcquisitionTime(acquisitionMicros, 0);
+
+	unsigned long start = sim->transactionCount();
+	chrono::steady_clock::time_point began = chrono::steady_clock::now();
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(lidar.distance(false));
+	}
+	double elapsedMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - began).count();
+	// Each distance() is one trigger, the status polls and one result read
+	state.counters["polls"] = benchmark::Counter(
+		(double) (sim->transactionCount() - start) - 2.0 * state.iterations(), benchmark::Counter::kAvgIterations);
+	state.counters["overshoot_us"] = benchmark::Counter(
+		elapsedMicros - (double) acquisitionMicros * state.iterations(), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_BusyWait)->Arg(500)->Arg(2000)->Arg(7500)->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+//--------------------------------------------------------------
+static void BM_StatusString(benchmark::State & state) {
+	int stat = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(LidarLite::statusString(stat));
+		stat = (stat + 1) & 0xff;
+	}
+}
+BENCHMARK(BM_StatusString);
+
+//--------------------------------------------------------------
+static void BM_StatusText(benchmark::State & state) {
+	int stat = 0;
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(LidarLiteStatus::text(stat));
+		stat = (stat + 1) & 0xff;
+	}
+}
+BENCHMARK(BM_StatusText);
+
+//--------------------------------------------------------------
+static void BM_StatusMonitor(benchmark::State & state) {
+	LidarLiteStatusMonitor monitor(1000);
+	int stat = 0;
+	for (auto _ : state) {
+		monitor.record(stat);
+		stat = (stat + 1) & 0xff;
+	}
+	benchmark::DoNotOptimize(monitor.count(LidarLite::STATUS_SIGNAL_INVALID));
+}
+BENCHMARK(BM_StatusMonitor);
+
+/* =============================================================================
+  BM_SharedMemoryPublish, BM_SharedMemoryRead
+  Cost on the acquisition thread of publishing a sample to shared memory, and
+  of another process's reader picking up the latest sample and draining the
+  ring (here in the same process, it only touches the mapping either way).
+============================================================================= */
+static void BM_SharedMemoryPublish(benchmark::State & state) {
+	LidarLiteSharedMemoryPublisher publisher("/lidarlite_benchmark", 4096);
+	LidarLiteSample sample = LidarLiteSample();
+	for (auto _ : state) {
+		publisher.publish(sample);
+		sample.sequence++;
+	}
+}
+BENCHMARK(BM_SharedMemoryPublish);
+
+static void BM_SharedMemoryRead(benchmark::State & state) {
+	LidarLiteSharedMemoryPublisher publisher("/lidarlite_benchmark", 4096);
+	LidarLiteSharedMemoryReader reader("/lidarlite_benchmark");
+	LidarLiteSample sample = LidarLiteSample();
+	LidarLiteSample out[64];
+	for (auto _ : state) {
+		for (int i = 0; i < 64; i++) publisher.publish(sample);
+		benchmark::DoNotOptimize(reader.latest(sample));
+		benchmark::DoNotOptimize(reader.read(out, 64));
+	}
+	state.SetItemsProcessed(state.iterations() * 64);
+}
+BENCHMARK(BM_SharedMemoryRead);
+
+/* =============================================================================
+  BM_StreamServerDelivery
+  Publishes range(0) samples at a time, in frames of range(0), and waits for
+  a subscriber on another thread to receive them: end-to-end throughput of
+  the publish ring, the server thread and a Unix-domain socket.
+============================================================================= */
+static void BM_StreamServerDelivery(benchmark::State & state) {
+	const char * path = "/tmp/lidarlite_benchmark.sock";
+	size_t batch = (size_t) state.range(0);
+	LidarLiteStreamServer server(batch, 20, 4 * batch);
+	server.listenUnix(path);
+	server.start();
+	LidarLiteStreamClient client;
+	client.connectUnix(path);
+	while (server.subscriberCount() < 1) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	std::atomic<unsigned long long> received(0);
+	std::thread subscriber([&client, &received]() {
+		vector<LidarLiteRecord> records;
+		while (client.readFrame(records)) received += records.size();
+	});
+
+	LidarLiteSample sample = LidarLiteSample();
+	unsigned long long published = 0;
+	for (auto _ : state) {
+		for (size_t i = 0; i < batch; i++) {
+			server.publish(sample);
+			sample.sequence++;
+		}
+		published += batch;
+		while (received.load() < published) std::this_thread::yield();
+	}
+	server.stop();
+	subscriber.join();
+	state.SetItemsProcessed((int64_t) published);
+}
+BENCHMARK(BM_StreamServerDelivery)->Arg(1)->Arg(16)->Arg(256)->UseRealTime();
+
+/* =============================================================================
+  BM_CorrelationAnalyze
+  Peak, second peak and noise floor of a full 256 entry correlation record,
+  using whichever kernel was compiled in (see LidarLiteCorrelation::kernelName).
+============================================================================= */
+static void BM_CorrelationAnalyze(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator(0, 0);
+	sim->setEcho(0x62, 700, 60);
+	LidarLite lidar;
+	setUp(lidar, sim);
+	lidar.distance();
+	LidarLiteCorrelationRecord record;
+	lidar.readCorrelationRecord(record);
+	for (auto _ : state) {
+		benchmark::DoNotOptimize(LidarLiteCorrelation::analyze(record.values, record.size));
+	}
+	state.SetLabel(LidarLiteCorrelation::kernelName());
+}
+BENCHMARK(BM_CorrelationAnalyze);
+
+/* =============================================================================
+  BM_ScanToCartesian
+  Polar to Cartesian conversion of a 4096 point sweep with every eighth point
+  invalid, using whichever kernel was compiled in (see LidarLiteScanner::kernelName).
+============================================================================= */
+static void BM_ScanToCartesian(benchmark::State & state) {
+	const size_t count = 4096;
+	vector<float> distance(count), ux(count), uy(count), uz(count), x(count), y(count), z(count);
+	for (size_t i = 0; i < count; i++) {
+		distance[i] = (i % 8 == 0) ? -1 : 100 + (float) (i % 500);
+		ux[i] = 0.8f;
+		uy[i] = 0.36f;
+		uz[i] = 0.48f;
+	}
+	for (auto _ : state) {
+		LidarLiteScanner::toCartesian(distance.data(), ux.data(), uy.data(), uz.data(), x.data(), y.data(), z.data(), count);
+		benchmark::DoNotOptimize(x.data());
+		benchmark::ClobberMemory();
+	}
+	state.counters["points_per_s"] = benchmark::Counter((double) count * state.iterations(), benchmark::Counter::kIsRate);
+	state.SetLabel(LidarLiteScanner::kernelName());
+}
+BENCHMARK(BM_ScanToCartesian);
+
+/* =============================================================================
+  BM_ScanSweep
+  A 61 point sweep of a simulated room with a mount settling in range(0) us,
+  on a free bus. With the next move commanded as each acquisition completes,
+  a point should cost about the acquisition plus the settling time.
+============================================================================= */
+static void BM_ScanSweep(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator(0, 0);
+	LidarLite lidar;
+	setUp(lidar, sim);
+	shared_ptr<LidarLiteActuator> mount(new LidarLiteSimulatedActuator(sim, 0x62,
+		LidarLiteSimulatedActuator::roomScene(400, 600, 250, 100), 20000, (int) state.range(0)));
+	LidarLiteScanner scanner(lidar, mount);
+	LidarLiteScanPattern pattern;
+	pattern.panMin = -60;
+	pattern.panMax = 60;
+	pattern.panStep = 2;
+	scanner.setPattern(pattern);
+	LidarLiteScanFrame frame;
+	size_t points = 0;
+	for (auto _ : state) {
+		scanner.scan(frame);
+		points += frame.size();
+	}
+	state.counters["points_per_s"] = benchmark::Counter((double) points, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ScanSweep)->Arg(0)->Arg(500)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/* =============================================================================
+  BM_ReaderDeliveryLatency
+  End-to-end latency of the threaded reader (the loop ThreadedLidarLite runs):
+  from startDistanceRead() to isOutputNew() turning true on the calling thread.
+============================================================================= */
+static void BM_ReaderDeliveryLatency(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator((int) state.range(0), (int) state.range(1));
+	LidarLiteReader reader;
+	setUp(reader, sim);
+	reader.start();
+	int distance, signalStrength;
+	for (auto _ : state) {
+		reader.startDistanceRead();
+		while (!reader.isOutputNew()) {}
+		reader.getOutput(distance, signalStrength);
+	}
+	reader.stop();
+}
+BENCHMARK(BM_ReaderDeliveryLatency)->Args({0, 0})->Args({50, 90})->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+/* =============================================================================
+  BM_ReaderThroughput
+  Samples per second delivered through drain() with the reader measuring as
+  fast as possible, serially (range(2) = 0) or pipelined (1).
+============================================================================= */
+static void BM_ReaderThroughput(benchmark::State & state) {
+	shared_ptr<LidarLiteSimulator> sim = makeSimulator((int) state.range(0), (int) state.range(1));
+	LidarLiteReader reader;
+	setUp(reader, sim);
+	reader.setSchedule(LidarLiteReader::SCHEDULE_AS_FAST_AS_POSSIBLE);
+	reader.setPipelined(state.range(2) != 0);
+	reader.start();
+	vector<LidarLiteSample> samples;
+	samples.reserve(4096);
+	size_t total = 0;
+	for (auto _ : state) {
+		samples.clear();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		total += reader.drain(samples);
+	}
+	reader.stop();
+	state.counters["samples_per_s"] = benchmark::Counter((double) total, benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_ReaderThroughput)->Args({0, 0, 0})->Args({50, 90, 0})->Args({0, 0, 1})->Args({50, 90, 1})
+	->UseRealTime()->Unit(benchmark::kMillisecond);
+
+/* =============================================================================
+  BM_SharedBus
+  range(0) sensors on one free bus, each measured at 100Hz, either by a
+  LidarLiteReader apiece (range(1) = 0) or by one LidarLiteBusArbiter (1).
+  cpu_percent is the process CPU time over the wall time, which should stay
+  flat with the arbiter as sensors are added.
+============================================================================= */
+static double processCpuSeconds() {
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+}
+
+static void BM_SharedBus(benchmark::State & state) {
+	int sensors = (int) state.range(0);
+	bool arbitrated = state.range(1) != 0;
+	shared_ptr<LidarLiteSimulator> sim(new LidarLiteSimulator());
+	vector< shared_ptr<LidarLiteReader> > readers;
+	LidarLiteBusArbiter arbiter(sim);
+	for (int i = 0; i < sensors; i++) {
+		unsigned char address = (unsigned char) (0x10 + 2 * i);
+		sim->addDevice(address);
+		sim->setTarget(address, 250, 120, 2);
+		sim->setAcquisitionTime(address, ACQUISITION_MICROS, 0);
+		shared_ptr<LidarLiteReader> reader(new LidarLiteReader());
+		reader->setBus(sim);
+		reader->begin(0, false, false, address);
+		reader->setAcquisitionTime(ACQUISITION_MICROS, 0);
+		if (arbitrated) {
+			arbiter.addSensor(reader, 100);
+		} else {
+			reader->setSchedule(LidarLiteReader::SCHEDULE_FIXED_RATE, 100);
+			readers.push_back(reader);
+		}
+	}
+
+	for (size_t i = 0; i < readers.size(); i++) readers[i]->start();
+	if (arbitrated) arbiter.start();
+	vector<LidarLiteSample> samples;
+	samples.reserve(4096);
+	size_t total = 0;
+	double cpuStart = processCpuSeconds();
+	std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+	for (auto _ : state) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		for (int i = 0; i < sensors; i++) {
+			samples.clear();
+			total += arbitrated ? arbiter.drain(i, samples) : readers[i]->drain(samples);
+		}
+	}
+	double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+	double cpu = processCpuSeconds() - cpuStart;
+	arbiter.stop();
+	for (size_t i = 0; i < readers.size(); i++) readers[i]->stop();
+	state.counters["samples_per_s"] = benchmark::Counter((double) total, benchmark::Counter::kIsRate);
+	state.counters["cpu_percent"] = 100 * cpu / wall;
+}
+BENCHMARK(BM_SharedBus)->ArgsProduct({{1, 4, 16}, {0, 1}})->UseRealTime()->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -13,17 +13,25 @@ void ofApp::setup(){
 	cout << "LIDAR Lite hardware version: " << myLidarLite.hardwareVersion() << endl;
 	cout << "LIDAR Lite software version: " << myLidarLite.softwareVersion() << endl;
 	
-	wDistance = -1;
+	// Power user technique:
+	// Weighting each new distance by the measured signal strength
+	// helps eliminate noise created by the sun and by not detecting any objects.
+	// The filter runs on the LidarLite thread, getOutput() returns the weighted
+	// distance, or -1 when the signal was too weak (below 20, full weight at 80).
+	shared_ptr<LidarLiteFilterPipeline> filter(new LidarLiteFilterPipeline());
+	filter->add(shared_ptr<LidarLiteFilter>(new LidarLiteOutlierFilter()));
+	filter->add(shared_ptr<LidarLiteFilter>(new LidarLiteSignalWeightedFilter(20, 80)));
+	myLidarLite.setFilter(filter);
     
+    // Measure at 100Hz regardless of the frame rate
+    // (SCHEDULE_ON_DEMAND measures once per startDistanceRead() instead)
+    myLidarLite.setSchedule(ThreadedLidarLite::SCHEDULE_FIXED_RATE, 100);
     myLidarLite.start();
 }
 
 //--------------------------------------------------------------
 void ofApp::update(){
-    int success = myLidarLite.startDistanceRead();
-    if (success) {
-        cout << "SUCCESS: myLidarLite.startRead();" << endl;
-    }
+
 }
 
 //--------------------------------------------------------------
@@ -40,29 +48,12 @@ void ofApp::draw(){
         // Read the distance and signalStrength
         myLidarLite.getOutput(distance, signalStrength);
         
-        cout << "Distance = " << distance << " cm, ";
+        cout << "wDistance = " << distance << " cm, ";
         
         // Read the status (useful for debug)
         //int status = myLidarLite.status();
         //cout << myLidarLite.statusString(status);
         
-        // Power user technique: 
-        // Weighting the new distance value by the measured signal strength
-        // Helps eliminate noise created by the sun and by not detecting any objects 
-        int minSigStrength = 20; // signal strength minimum
-        int fullSigStrength = 80; // signal strength that gets full weight
-        float weight;
-        if (signalStrength < minSigStrength) {
-            // We're below the min signal strength
-            // Set distance to -1 to indicate no object was found
-            wDistance = -1; // Indicates no object was found
-        } else {
-            // Weight by the signal strength
-            weight = ofMap(signalStrength, minSigStrength, fullSigStrength, 0.05f, 1.f, true);
-            // Calculate the weighted distance
-            wDistance = ((float) distance)*weight + ((float) wDistance)*(1-weight);
-        }
-        cout << "wDistance = " << wDistance << " cm, ";
         cout << "signalStrength = " << signalStrength << ", ";
         cout << endl;
     }
@@ -21,5 +21,4 @@ class ofApp : public ofBaseApp{
         void exit();
 		
 		ThreadedLidarLite myLidarLite;
-		int wDistance;
 };
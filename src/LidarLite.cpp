@@ -7,12 +7,11 @@ This work is licensed under the Creative Commons
 Attribution-ShareAlike 3.0 Unported License. 
 To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
 
-Leverages WiringPi by drogon
 Derived from https://github.com/PulsedLight3D/LIDARLite_v2_Arduino_Library/tree/master/LIDARLite
 	
 Requirements:
-	Install wiring pi - http://wiringpi.com/
-	Add PROJECT_LDFLAGS += -lwiringPi to the PROJECT LINKER FLAGS section of config.make
+	Enable the Linux i2c-dev driver (see README.md), or inject a LidarLiteSimulator
+	with setBus() to run without a sensor attached.
 	
 See LIDAR Lite documentation for more info
 http://kb.pulsedlight3d.com/
@@ -20,20 +19,77 @@ https://github.com/PulsedLight3D/
 */
 
 #include "LidarLite.hpp"
-#include <wiringPiI2C.h>
-#include <sstream>
-#include <iostream>
-#include <iomanip>
+#include "LidarLiteCorrelation.hpp"
+#include "LidarLiteLinuxI2cBus.hpp"
+#include "LidarLiteStatus.hpp"
+#include <cmath>
 #include <unistd.h>
 
+typedef chrono::steady_clock LidarLiteClock;
+
+// Timing constants are passed by reference (std::min, chrono constructors) and need a definition
+const int LidarLite::DEFAULT_ACQUISITION_MICROS;
+const int LidarLite::DEFAULT_DC_CORRECTION_MICROS;
+const int LidarLite::DEFAULT_BUSY_TIMEOUT_MICROS;
+const int LidarLite::DEFAULT_READY_TIMEOUT_MICROS;
+const int LidarLite::MIN_POLL_BACKOFF_MICROS;
+const int LidarLite::MAX_POLL_BACKOFF_MICROS;
+const int LidarLite::MEASURE_DELAY_MICROS_PER_COUNT;
+const int LidarLite::CORRELATION_TRANSFER_BYTES;
+
 //--------------------------------------------------------------
 LidarLite::LidarLite() {
-	fd = -1;
+	address = 0x62;
 	errorReporting = false;
 	logLevel = NONE;
 	REG_STATUS = REG_STATUS_V21;
 	hwVersion = 0;
 	swVersion = 0;
+	error = ERROR_NONE;
+	lastStatus = -1;
+	activeConfiguration = 0;
+	acquisitionMicros = DEFAULT_ACQUISITION_MICROS;
+	dcCorrectionMicros = DEFAULT_DC_CORRECTION_MICROS;
+	busyTimeoutMicros = DEFAULT_BUSY_TIMEOUT_MICROS;
+	acquisitionPending = false;
+	acquisitionDueMicros = 0;
+	continuous = false;
+	continuousPeriodMicros = 0;
+	readyPending = false;
+	readyMicros = -1;
+	velocityMode = false;
+	pipelined = false;
+	pipelineReadoutMicros = -1;
+	velocityScale = VELOCITY_SCALE_0_10_MPS;
+	adaptiveStabilization = false;
+	stabilizationInterval = 100;
+	stabilizationNoiseDrift = 8;
+	measurementsSinceStabilization = 0;
+	noiseAverage = -1;
+	referenceNoise = -1;
+	stabilizationRequested = true;
+	lastAcquisitionStabilized = false;
+	stabilizations = 0;
+}
+
+//--------------------------------------------------------------
+LidarLite::LidarLite(shared_ptr<LidarLiteI2cBus> bus) : LidarLite() {
+	this->bus = bus;
+}
+
+/* =============================================================================
+  setBus
+  Selects the I2C transport used by this LidarLite. Must be called before
+  begin(). If no bus is set, begin() opens /dev/i2c-1. A bus may be shared by
+  several LidarLite objects with different addresses.
+============================================================================= */
+void LidarLite::setBus(shared_ptr<LidarLiteI2cBus> bus) {
+	this->bus = bus;
+}
+
+//--------------------------------------------------------------
+shared_ptr<LidarLiteI2cBus> LidarLite::getBus() {
+	return bus;
 }
 
 /* =============================================================================
@@ -44,7 +100,8 @@ LidarLite::LidarLite() {
   1.  Turn on error reporting, off by default
   2.  Start Wire (i.e. turn on I2C)
   3.  Enable 400kHz I2C, 100kHz by default
-  4.  Set configuration for sensor
+  4.  Wait for the sensor to answer and read its versions (see identify)
+  5.  Set configuration for sensor and wait until it reports ready
   Parameters
   ------------------------------------------------------------------------------
   - configuration: set the configuration for the sensor
@@ -58,38 +115,64 @@ LidarLite::LidarLite() {
     used primarily for debugging purposes by PulsedLight
   - LidarLiteI2cAddress (optional): Default: 0x62, the default LIDAR-Lite
     address. If you change the address, fill it in here.
+  Instead of sleeping a fixed 100ms after configuring (200ms on v1), begin()
+  polls the status register until the sensor is idle, see timeToReadyMicros().
 ============================================================================= */
 void LidarLite::begin(int configuration, bool fasti2c, bool showErrorReporting, char LidarLiteI2cAddress){
-	if (logLevel <= VERBOSE) cout << "LidarLite::begin" << endl;
+	log<VERBOSE>("LidarLite::begin");
 	
 	errorReporting = showErrorReporting;
 	
 	if (fasti2c){
 		// fast I2C not yet supported, come again soon
-		cout << "fast I2C not yet supported, come again soon" << endl;
+		log<WARN>("fast I2C not yet supported, come again soon");
 	}
 	
 	// initialize the LidarLite
-	fd = wiringPiI2CSetup(LidarLiteI2cAddress);
+	identify((unsigned char) LidarLiteI2cAddress);
+
+	if (hasBegun()) {
+		configure(configuration);
+	}
 	
-	hwVersion = readByte(fd, REG_HARDWARE_VERSION, false);
-	swVersion = readByte(fd, REG_SOFTWARE_VERSION, false);
+	return;
+}
+
+/* =============================================================================
+  identify
+  Opens the bus if needed, waits for the sensor at address to answer and to
+  finish booting, then reads its hardware and software versions. Used by
+  begin(), and by LidarLiteArray to bring sensors up without configuring them.
+  Returns false if the sensor didn't answer within timeoutMicros.
+============================================================================= */
+bool LidarLite::identify(unsigned char LidarLiteI2cAddress, int timeoutMicros) {
+	log<VERBOSE>("LidarLite::identify");
+	if (!bus) bus = shared_ptr<LidarLiteI2cBus>(new LidarLiteLinuxI2cBus());
+	address = LidarLiteI2cAddress;
+	readyStart = LidarLiteClock::now();
+	readyMicros = -1;
 	
-	if (hardwareVersion() < 21) {
-		REG_STATUS = REG_STATUS_V20;
-		status();
-		//ofSleepMillis(100);
-		usleep(100000);
+	// A booting sensor NAKs, poll until it answers
+	LidarLiteClock::time_point deadline = readyStart + chrono::microseconds(timeoutMicros);
+	int backoffMicros = MIN_POLL_BACKOFF_MICROS;
+	hwVersion = bus->readReg8(address, REG_HARDWARE_VERSION);
+	while (hwVersion == -1 && bus->isOpen() && LidarLiteClock::now() < deadline) {
+		usleep(backoffMicros);
+		backoffMicros = min(backoffMicros * 2, MAX_POLL_BACKOFF_MICROS);
+		hwVersion = bus->readReg8(address, REG_HARDWARE_VERSION);
 	}
-
-	if (fd > -1) {
-			configure(configuration);
-			//ofSleepMillis(100);
-			usleep(100000);
-		//}
+	if (hwVersion == -1) {
+		log<WARN>("LidarLite::identify no answer");
+		error = ERROR_BUS;
+		return false;
 	}
+	swVersion = readByte(REG_SOFTWARE_VERSION, false);
 	
-	return;
+	REG_STATUS = (hardwareVersion() < 21) ? REG_STATUS_V20 : REG_STATUS_V21;
+	
+	readyPending = true;
+	readyDeadline = deadline;
+	return waitUntilReady();
 }
 
 /* =============================================================================
@@ -97,8 +180,8 @@ void LidarLite::begin(int configuration, bool fasti2c, bool showErrorReporting,
 	Returns whether begin successfully initialized the LIDAR Lite
 	============================================================================= */
 bool LidarLite::hasBegun() {
-	if (logLevel <= VERBOSE) cout << "LidarLite::hasBegun" << endl;
-	if (fd > -1) {
+	log<VERBOSE>("LidarLite::hasBegun");
+	if (bus && bus->isOpen()) {
 		return true;
 	}
 	return false;
@@ -119,35 +202,96 @@ bool LidarLite::hasBegun() {
       great for stronger singles) can be a little noisier
 ============================================================================= */
 void LidarLite::configure(int configuration){
-	if (logLevel <= VERBOSE) cout << "LidarLite::configure" << endl;
+	log<VERBOSE>("LidarLite::configure");
+	if (startConfigure(configuration)) waitUntilReady();
+}
+
+//--------------------------------------------------------------
+bool LidarLite::startConfigure(int configuration){
+	log<VERBOSE>("LidarLite::startConfigure");
 	int writeSuccess = 0;
   switch (configuration){
     case 0: //  Default configuration
-			writeSuccess = wiringPiI2CWriteReg8(fd, 0x00, 0x00);
-			//ofSleepMillis(1);
-			usleep(1000);
+			writeSuccess = bus->writeReg8(address, 0x00, 0x00);
     break;
     case 1: //  Set aquisition count to 1/3 default value, faster reads, slightly
             //  noisier values
-			writeSuccess = wiringPiI2CWriteReg8(fd, 0x04,0x00);
-			//ofSleepMillis(1);
-			usleep(1000);
+			writeSuccess = bus->writeReg8(address, 0x04,0x00);
     break;
     case 2: //  Low noise, low sensitivity: Pulls decision criteria higher
             //  above the noise, allows fewer false detections, reduces
             //  sensitivity
-      writeSuccess = wiringPiI2CWriteReg8(fd, 0x1c,0x20);
-			//ofSleepMillis(1);
-			usleep(1000);
+      writeSuccess = bus->writeReg8(address, 0x1c,0x20);
     break;
     case 3: //  High noise, high sensitivity: Pulls decision criteria into the
             //  noise, allows more false detections, increses sensitivity
-      writeSuccess = wiringPiI2CWriteReg8(fd, 0x1c,0x60);
-			//ofSleepMillis(1);
-			usleep(1000);
+      writeSuccess = bus->writeReg8(address, 0x1c,0x60);
     break;
   }
-	if (logLevel <= INFO) cout << "writeSuccess = " << writeSuccess << endl;
+	// Only the acquisition count changes how long a measurement takes
+	if (configuration == 0 || configuration == 1) activeConfiguration = configuration;
+	log<INFO>("writeSuccess = ", writeSuccess);
+	if (writeSuccess == -1) {
+		error = ERROR_BUS;
+		return false;
+	}
+	
+	// A reset takes the sensor offline for a while, the others apply at once.
+	// Either way the status register tells when it's done.
+	readyPending = true;
+	readyDeadline = LidarLiteClock::now() + chrono::microseconds(DEFAULT_READY_TIMEOUT_MICROS);
+	return true;
+}
+
+/* =============================================================================
+  Readiness
+  After identify() or startConfigure() the sensor may be booting or
+  resetting: it NAKs or reports busy until it is done.
+  ------------------------------------------------------------------------------
+  - pollReady() reads the status register once: 1 if ready, 0 if not yet,
+    -1 if the deadline passed
+  - waitUntilReady() polls with a growing back-off (50us up to 1ms)
+  - timeToReadyMicros() is how long the sensor took from the start of the last
+    begin()/identify() until it was ready after configuration, -1 if it
+    wasn't
+============================================================================= */
+int LidarLite::pollReady() {
+	if (!readyPending) return (readyMicros >= 0) ? 1 : -1;
+	int stat = bus->readReg8(address, REG_STATUS);
+	LidarLiteClock::time_point now = LidarLiteClock::now();
+	if (stat != -1 && (((unsigned char) stat) & STATUS_BUSY) == 0) {
+		readyPending = false;
+		readyMicros = (int) chrono::duration_cast<chrono::microseconds>(now - readyStart).count();
+		error = ERROR_NONE;
+		return 1;
+	}
+	if (now >= readyDeadline) {
+		log<WARN>("LidarLite::pollReady timeout");
+		readyPending = false;
+		readyMicros = -1;
+		error = (stat == -1) ? ERROR_BUS : ERROR_BUSY_TIMEOUT;
+		return -1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------
+bool LidarLite::waitUntilReady() {
+	int backoffMicros = MIN_POLL_BACKOFF_MICROS;
+	int ready;
+	while ((ready = pollReady()) == 0) {
+		LidarLiteClock::time_point now = LidarLiteClock::now();
+		LidarLiteClock::time_point wake = now + chrono::microseconds(backoffMicros);
+		if (wake > readyDeadline) wake = readyDeadline;
+		if (wake > now) usleep((useconds_t) chrono::duration_cast<chrono::microseconds>(wake - now).count());
+		backoffMicros = min(backoffMicros * 2, MAX_POLL_BACKOFF_MICROS);
+	}
+	return ready == 1;
+}
+
+//--------------------------------------------------------------
+int LidarLite::timeToReadyMicros() {
+	return readyMicros;
 }
 
 /* =============================================================================
@@ -169,8 +313,14 @@ void LidarLite::configure(int configuration){
     stabilization/correction. If set to false, it will read
   - faster, but you will need to sabilize DC every once in awhile (ex. 1 out of
     every 100 readings is typically good).
+    setAdaptiveStabilization() does this for you.
   - LidarLiteI2cAddress (optional): Default: 0x62, the default LIDAR-Lite
     address. If you change the address, fill it in here.
+  Returns
+  ------------------------------------------------------------------------------
+  A LidarLiteResult: the distance in cm (it converts to int, -1 on error), the
+  error category and the status byte seen when the busy flag cleared. Use
+  isValid() to drop failed reads and no-signal measurements in one test.
   Example Arduino Usage
   ------------------------------------------------------------------------------
   1.  // take a reading with DC stabilization and the 0x62 default i2c address
@@ -194,36 +344,417 @@ void LidarLite::configure(int configuration){
     ister 0x8f. 0x8f = 10001111 and 0x0f = 00001111, meaning that 0x8f is 0x0f
     with the high byte set to "1", ergo it autoincrements.
 ============================================================================= */
-int LidarLite::distance(bool stablizePreampFlag, bool takeReference){
-	if (logLevel <= VERBOSE) cout << "LidarLite::distance" << endl;
+LidarLiteResult LidarLite::distance(bool stablizePreampFlag, bool takeReference){
+	log<VERBOSE>("LidarLite::distance");
+	if (pipelined) endPipeline();
+	LidarLiteStageTimer timer(statistics.get(), LidarLiteStats::STAGE_MEASUREMENT);
 	int loVal, hiVal, writeSuccess = 0;
 	
-  if(stablizePreampFlag){
-    // Take acquisition & correlation processing with DC correction
-		writeSuccess = wiringPiI2CWriteReg8(fd, REG_MEASURE, VAL_MEASURE);
-		//ofSleepMillis(1);
-		usleep(1000);
-  }else{
-    // Take acquisition & correlation processing without DC correction
-		writeSuccess = wiringPiI2CWriteReg8(fd, REG_MEASURE, VAL_MEASURE_NO_DC_CRCT);
-		//ofSleepMillis(1);
-		usleep(1000);
-  }
+	// Take acquisition & correlation processing with or without DC correction.
+	// readByte sleeps through most of the expected acquisition time.
+	writeSuccess = startAcquisition(stabilizeNow(stablizePreampFlag));
+	
+	log<DEBUG>("writeSuccess = ", writeSuccess);
+	
+	// Get the high and low bytes in one auto-incrementing read from 0x8f,
+	// return -1 if error occurred
+	unsigned char val[2];
+	if (!readBlock(REG_HI_DISTANCE | REG_AUTO_INCREMENT, val, 2, true)) return makeResult(-1);
+	hiVal = val[0];
+	loVal = val[1];
+	noteResult(lastStatus, -1, lastAcquisitionStabilized);
+	log<VERBOSE>("hiVal, loVal = ", hiVal, loVal);
+	
+	return makeResult( (hiVal << 8) + loVal);
+}
+
+/* =============================================================================
+  Measure
+  Takes a measurement and reads every result register in one transaction
+  Process
+  ------------------------------------------------------------------------------
+  1.  Write 0x04 (or 0x03 without DC stabilization) to register 0x00
+  2.  Wait for the busy flag to clear, keeping the last status byte
+  3.  Read five bytes from 0x8c: correlation peak (0x0c), max noise (0x0d),
+      signal strength (0x0e) and the distance high/low bytes (0x0f, 0x10)
+  Compared to distance() followed by signalStrength(), maxNoise() and
+  correlationPeakValue() this is one read transaction instead of five, and
+  the busy flag is only waited on once.
+  Example Usage
+  ------------------------------------------------------------------------------
+      LidarLiteMeasurement m;
+      if (myLidarLiteInstance.measure(m)) {
+          cout << m.distance << " cm, signal " << m.signalStrength << endl;
+      }
+============================================================================= */
+bool LidarLite::measure(LidarLiteMeasurement & measurement, bool stablizePreampFlag) {
+	log<VERBOSE>("LidarLite::measure");
+	if (pipelined) endPipeline();
+	LidarLiteStageTimer timer(statistics.get(), LidarLiteStats::STAGE_MEASUREMENT);
+	
+	int writeSuccess = startAcquisition(stabilizeNow(stablizePreampFlag));
+	log<DEBUG>("writeSuccess = ", writeSuccess);
+	
+	return readResult(measurement, true, lastAcquisitionStabilized);
+}
+
+/* =============================================================================
+  Pipelined measurement
+  measure() leaves the sensor idle from the moment its result is latched until
+  the next call, i.e. during the whole result readout and whatever the caller
+  does with it. measurePipelined() triggers the next measurement as soon as
+  the busy flag clears and reads the result while that measurement runs. The
+  result registers only change when a measurement completes, so this is safe
+  as long as the readout is done well within an acquisition:
+  ------------------------------------------------------------------------------
+      measure():           [acquire][read][caller][acquire][read][caller]
+      measurePipelined():  [acquire][acquire            ][acquire            ]
+                                    [read][caller]       [read][caller]
+  At a sustained rate each sample costs max(acquisition, readout + caller)
+  instead of their sum. The readout is timed, and when it takes more than half
+  the expected acquisition (slow bus, configure(1)), or on v1 hardware, which
+  doesn't answer while busy, the next measurement is triggered right after the
+  readout instead, still overlapping the caller's work. Each result belongs to
+  a measurement started by the previous call, so only use it when calls follow
+  each other closely; the first call of a pipeline waits for a full
+  acquisition.
+  Example Usage
+  ------------------------------------------------------------------------------
+      LidarLiteMeasurement m;
+      while (myLidarLiteInstance.measurePipelined(m, false)) {
+          process(m);		// The next measurement runs meanwhile
+      }
+      myLidarLiteInstance.endPipeline();
+============================================================================= */
+bool LidarLite::measurePipelined(LidarLiteMeasurement & measurement, bool stablizePreampFlag) {
+	log<VERBOSE>("LidarLite::measurePipelined");
+	LidarLiteStageTimer timer(statistics.get(), LidarLiteStats::STAGE_MEASUREMENT);
+	
+	if (!pipelined || !acquisitionPending) {
+		if (startAcquisition(stabilizeNow(stablizePreampFlag)) == -1) {
+			error = ERROR_BUS;
+			acquisitionPending = false;
+			pipelined = false;
+			return false;
+		}
+	}
+	pipelined = true;
 	
-	if (logLevel <= DEBUG) cout << "writeSuccess = " << writeSuccess << endl;
+	error = waitWhileBusy();
+	if (error != ERROR_NONE) {
+		log<WARN>("> Bailout");
+		if (statistics) statistics->count(LidarLiteStats::COUNTER_BAILOUTS);
+		// Start over so one bad measurement doesn't stall the pipeline
+		triggerNext(stablizePreampFlag);
+		return false;
+	}
+	
+	bool ahead = hardwareVersion() >= 21 && pipelineReadoutMicros >= 0 &&
+		2 * pipelineReadoutMicros < expectedAcquisitionMicros(false);
+	// Triggering ahead overwrites lastAcquisitionStabilized with the next acquisition's flag
+	bool stabilized = lastAcquisitionStabilized;
+	if (ahead) triggerNext(stablizePreampFlag);
+	
+	LidarLiteClock::time_point readStart = LidarLiteClock::now();
+	bool success = readResult(measurement, false, stabilized);
+	pipelineReadoutMicros = (int) chrono::duration_cast<chrono::microseconds>(LidarLiteClock::now() - readStart).count();
+	
+	if (!ahead) triggerNext(stablizePreampFlag);
+	return success;
+}
+
+//--------------------------------------------------------------	
+void LidarLite::triggerNext(bool stablizePreampFlag) {
+	if (startAcquisition(stabilizeNow(stablizePreampFlag)) == -1) {
+		acquisitionPending = false;
+		pipelined = false;
+	}
+}
+
+//--------------------------------------------------------------	
+void LidarLite::endPipeline() {
+	if (!pipelined) return;
+	log<VERBOSE>("LidarLite::endPipeline");
+	pipelined = false;
+	pipelineReadoutMicros = -1;
+	// Its result is dropped, but the next measurement mustn't be triggered while it runs
+	if (acquisitionPending) waitWhileBusy();
+}
+
+//--------------------------------------------------------------	
+bool LidarLite::isPipelined() {
+	return pipelined;
+}
+
+/* =============================================================================
+  Split-phase measurement
+  measure() triggers, waits and reads in one blocking call. When several
+  LidarLites share a bus it is faster to trigger all of them, then collect the
+  results as each one finishes, so that their acquisitions overlap:
+  ------------------------------------------------------------------------------
+  1.  trigger() writes the measure command and returns
+  2.  expectedCompletion() tells when polling becomes worthwhile
+  3.  pollCompletion() reads the status register once without sleeping
+  4.  readMeasurement() reads the result registers once it returned 1
+============================================================================= */
+bool LidarLite::trigger(bool stablizePreampFlag) {
+	log<VERBOSE>("LidarLite::trigger");
+	if (pipelined) endPipeline();
+	if (startAcquisition(stabilizeNow(stablizePreampFlag)) == -1) {
+		error = ERROR_BUS;
+		acquisitionPending = false;
+		return false;
+	}
+	error = ERROR_NONE;
+	return true;
+}
+
+//--------------------------------------------------------------	
+chrono::steady_clock::time_point LidarLite::expectedCompletion() {
+	if (!acquisitionPending) return LidarLiteClock::now();
+	return acquisitionStart + chrono::microseconds(acquisitionDueMicros);
+}
+
+//--------------------------------------------------------------	
+int LidarLite::pollCompletion() {
+	int stat = status();
+	if (stat != -1 && (((unsigned char) stat ) & STATUS_BUSY) == 0) {
+		lastStatus = stat;
+		acquisitionPending = false;
+		error = ERROR_NONE;
+		return 1;
+	}
+	LidarLiteClock::time_point start = acquisitionPending ? acquisitionStart : LidarLiteClock::now();
+	if (!acquisitionPending || LidarLiteClock::now() >= start + chrono::microseconds(busyTimeoutMicros)) {
+		acquisitionPending = false;
+		error = ERROR_BUSY_TIMEOUT;
+		return -1;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------	
+bool LidarLite::readMeasurement(LidarLiteMeasurement & measurement) {
+	return readResult(measurement, false, lastAcquisitionStabilized);
+}
+
+/* =============================================================================
+  changeAddress
+  Moves the LidarLite to a new I2C address until it is power cycled. Every
+  LIDAR Lite powers up at 0x62, so on a multi-sensor bus each one has to be
+  powered up alone (e.g. through its power enable line) and moved before the
+  next one is switched on.
+  Process
+  ------------------------------------------------------------------------------
+  1.  Read the two byte serial number from 0x96 (0x16 auto-incrementing)
+  2.  Write it back to 0x18 and 0x19 to unlock the address change
+  3.  Write the new address to 0x1a
+  4.  Optionally write 0x08 to 0x1e to stop answering on the old address
+============================================================================= */
+bool LidarLite::changeAddress(unsigned char newAddress, bool disablePrimaryAddress) {
+	log<VERBOSE>("LidarLite::changeAddress");
+	unsigned char serial[2];
+	if (!readBlock(REG_SERIAL_NUMBER | REG_AUTO_INCREMENT, serial, 2, false)) return false;
+	
+	if (bus->writeReg8(address, REG_SERIAL_CHECK_HI, serial[0]) == -1 ||
+		bus->writeReg8(address, REG_SERIAL_CHECK_LO, serial[1]) == -1 ||
+		bus->writeReg8(address, REG_NEW_ADDRESS, newAddress) == -1) {
+		error = ERROR_BUS;
+		return false;
+	}
+	
+	// The control register write is addressed to the new address
+	if (bus->writeReg8(newAddress, REG_ADDRESS_CONTROL, 
+		disablePrimaryAddress ? VAL_DISABLE_PRIMARY_ADDRESS : 0x00) == -1) {
+		error = ERROR_BUS;
+		return false;
+	}
+	
+	address = newAddress;
+	error = ERROR_NONE;
+	return true;
+}
+
+//--------------------------------------------------------------	
+unsigned char LidarLite::getAddress() {
+	return address;
+}
+
+/* =============================================================================
+  Continuous (free-running) mode
+  The LIDAR Lite v2 can repeat measurements on its own: with a non-zero outer
+  loop count (0x11, 0xff = forever) one trigger starts a sequence that repeats
+  every REG_MEASURE_DELAY * 0.5ms when bit 5 of the acquisition mode register
+  (0x04) is set. The host then only reads results, either when the MODE pin
+  signals a completed measurement (see setModePin) or on a timer at the
+  measurement period.
+  Parameters
+  ------------------------------------------------------------------------------
+  - rateHz: requested measurement rate, limited by the acquisition time of the
+    active configuration. ~500Hz needs configure(1) and no DC stabilization.
+  - stablizePreampFlag (optional): Default: true, DC stabilize every
+    measurement of the sequence
+  Example Usage
+  ------------------------------------------------------------------------------
+      myLidarLiteInstance.begin(1);
+      myLidarLiteInstance.startContinuous(500, false);
+      LidarLiteMeasurement m;
+      while (myLidarLiteInstance.readContinuous(m)) {
+          cout << m.distance << endl;
+      }
+============================================================================= */
+bool LidarLite::startContinuous(int rateHz, bool stablizePreampFlag) {
+	log<VERBOSE>("LidarLite::startContinuous");
+	if (rateHz <= 0) return false;
+	endPipeline();
+	stopVelocity();
 	
-	// Get the low byte, return -1 if error occurred
-	loVal = readByte(fd, REG_LO_DISTANCE, true);
-	if (loVal == -1) return -1;
-	if (logLevel <= VERBOSE) cout << "loVal = " << loVal << endl;
+	int delayCounts = 1000000 / rateHz / MEASURE_DELAY_MICROS_PER_COUNT;
+	if (delayCounts < 1) delayCounts = 1;
+	if (delayCounts > 0xff) delayCounts = 0xff;
 	
-	// Get the high byte, return -1 if error occurred
-	hiVal = readByte(fd, REG_HI_DISTANCE, true);
-	if (hiVal == -1) return -1;
-	if (logLevel <= VERBOSE) cout << "hiVal = " << hiVal << endl;
+	unsigned char acqMode = (activeConfiguration == 1) ? VAL_ACQ_MODE_HIGH_SPEED : VAL_ACQ_MODE_DEFAULT;
+	if (bus->writeReg8(address, REG_MEASURE_DELAY, (unsigned char) delayCounts) == -1 ||
+		bus->writeReg8(address, REG_ACQ_MODE, acqMode | VAL_ACQ_MODE_USE_DELAY) == -1 ||
+		bus->writeReg8(address, REG_OUTER_LOOP_COUNT, VAL_LOOP_FOREVER) == -1 ||
+		startAcquisition(stablizePreampFlag) == -1) {
+		error = ERROR_BUS;
+		return false;
+	}
 	
-	return ( (hiVal << 8) + loVal);
-	//return lidar_read(fd);
+	continuous = true;
+	continuousPeriodMicros = max(delayCounts * MEASURE_DELAY_MICROS_PER_COUNT, acquisitionDueMicros);
+	continuousNextRead = acquisitionStart + chrono::microseconds(acquisitionDueMicros);
+	error = ERROR_NONE;
+	return true;
+}
+
+//--------------------------------------------------------------	
+void LidarLite::stopContinuous() {
+	log<VERBOSE>("LidarLite::stopContinuous");
+	if (!continuous) return;
+	unsigned char acqMode = (activeConfiguration == 1) ? VAL_ACQ_MODE_HIGH_SPEED : VAL_ACQ_MODE_DEFAULT;
+	bus->writeReg8(address, REG_OUTER_LOOP_COUNT, 0x00);
+	bus->writeReg8(address, REG_ACQ_MODE, acqMode);
+	acquisitionPending = false;
+	continuous = false;
+}
+
+//--------------------------------------------------------------	
+bool LidarLite::isContinuous() {
+	return continuous;
+}
+
+/* =============================================================================
+  Velocity mode
+  With 0x04 = 0xa0 every measure command makes two acquisitions
+  REG_VELOCITY_SCALE (0x68) * 0.5ms apart, and register 0x09 holds the signed change in
+  distance between them (cm, positive = moving away). measure() reads it in the
+  same burst as the result registers, so velocity costs one longer measurement
+  instead of two measurements and a host-side difference.
+  Parameters
+  ------------------------------------------------------------------------------
+  - scale (optional): Default: VELOCITY_SCALE_0_10_MPS, delay between the pair
+    in 0.5ms counts, written to 0x68. Shorter delays measure faster targets but one count of the
+    velocity register becomes a larger step.
+  Example Usage
+  ------------------------------------------------------------------------------
+      myLidarLiteInstance.startVelocity(LidarLite::VELOCITY_SCALE_0_25_MPS);
+      LidarLiteMeasurement m;
+      if (myLidarLiteInstance.measure(m)) {
+          cout << m.distance << "cm " << m.velocity << "cm/s" << endl;
+      }
+============================================================================= */
+bool LidarLite::startVelocity(unsigned char scale) {
+	log<VERBOSE>("LidarLite::startVelocity scale = ", scale);
+	if (scale == 0) return false;
+	endPipeline();
+	stopContinuous();
+	
+	if (bus->writeReg8(address, REG_VELOCITY_SCALE, scale) == -1 ||
+		bus->writeReg8(address, REG_ACQ_MODE, VAL_ACQ_MODE_VELOCITY) == -1) {
+		error = ERROR_BUS;
+		return false;
+	}
+	
+	velocityMode = true;
+	velocityScale = scale;
+	error = ERROR_NONE;
+	return true;
+}
+
+//--------------------------------------------------------------	
+void LidarLite::stopVelocity() {
+	log<VERBOSE>("LidarLite::stopVelocity");
+	if (!velocityMode) return;
+	unsigned char acqMode = (activeConfiguration == 1) ? VAL_ACQ_MODE_HIGH_SPEED : VAL_ACQ_MODE_DEFAULT;
+	bus->writeReg8(address, REG_ACQ_MODE, acqMode);
+	velocityMode = false;
+}
+
+//--------------------------------------------------------------	
+bool LidarLite::isVelocityMode() {
+	return velocityMode;
+}
+
+//--------------------------------------------------------------	
+void LidarLite::setModePin(shared_ptr<LidarLiteModePin> pin) {
+	modePin = pin;
+}
+
+/* =============================================================================
+  readContinuous
+  Blocks until the next free-running result is available and reads it. With a
+  mode pin the wait ends on its edge, otherwise at the next measurement period
+  (if the caller fell behind the schedule restarts from now rather than
+  reading a burst of stale results). The status register is read separately
+  since the busy flag is not waited on.
+============================================================================= */
+bool LidarLite::readContinuous(LidarLiteMeasurement & measurement) {
+	log<VERBOSE>("LidarLite::readContinuous");
+	if (!continuous) return false;
+	
+	if (modePin) {
+		int edge = modePin->waitForEdge(busyTimeoutMicros);
+		if (edge != 1) {
+			error = (edge == 0) ? ERROR_BUSY_TIMEOUT : ERROR_BUS;
+			return false;
+		}
+	} else {
+		LidarLiteClock::time_point now = LidarLiteClock::now();
+		if (continuousNextRead > now) {
+			usleep((useconds_t) chrono::duration_cast<chrono::microseconds>(continuousNextRead - now).count());
+			continuousNextRead += chrono::microseconds(continuousPeriodMicros);
+		} else {
+			continuousNextRead = now + chrono::microseconds(continuousPeriodMicros);
+		}
+	}
+	
+	lastStatus = status();
+	return readResult(measurement, false, lastAcquisitionStabilized);
+}
+
+//--------------------------------------------------------------	
+bool LidarLite::readResult(LidarLiteMeasurement & measurement, bool monitorBusyFlag, bool stabilized) {
+	// In velocity mode start the burst at 0x09 to pick up the velocity in the same transaction
+	unsigned char buffer[8];
+	unsigned char * val = buffer;
+	if (velocityMode) {
+		if (!readBlock(REG_VELOCITY | REG_AUTO_INCREMENT, buffer, 8, monitorBusyFlag)) return false;
+		measurement.velocity = (int) (signed char) buffer[0] * 2000 / velocityScale;
+		val += REG_CORR_PEAK_VAL - REG_VELOCITY;
+	} else {
+		if (!readBlock(REG_CORR_PEAK_VAL | REG_AUTO_INCREMENT, buffer, 5, monitorBusyFlag)) return false;
+		measurement.velocity = 0;
+	}
+	
+	measurement.correlationPeakValue = val[0];
+	measurement.maxNoise = val[1];
+	measurement.signalStrength = val[2];
+	measurement.distance = (val[3] << 8) + val[4];
+	measurement.status = lastStatus;
+	noteResult(lastStatus, measurement.maxNoise, stabilized);
+	return true;
 }
 
 /* =============================================================================
@@ -265,153 +796,437 @@ int LidarLite::distance(bool stablizePreampFlag, bool takeReference){
       int signalStrength = 0;
       signalStrength = myLidarLiteInstance.signalStrength();
   =========================================================================== */
-int LidarLite::signalStrength(){
-	if (logLevel <= VERBOSE) cout << "LidarLite::signalStrength" << endl;
-	int sigStrength = readByte(fd, REG_SIGNAL_STRENGTH, false);
-	if (sigStrength == -1) return -1;
-	else return ((int)((unsigned char) sigStrength));
+LidarLiteResult LidarLite::signalStrength(){
+	log<VERBOSE>("LidarLite::signalStrength");
+	int sigStrength = readByte(REG_SIGNAL_STRENGTH, false);
+	if (sigStrength == -1) return makeResult(-1);
+	else return makeResult((int)((unsigned char) sigStrength));
 }
 
 //--------------------------------------------------------------	
-int LidarLite::maxNoise(){
-	if (logLevel <= VERBOSE) cout << "LidarLite::maxNoise" << endl;
-	int maxNoise = readByte(fd, REG_MAX_NOISE, false);
-	if (maxNoise == -1) return -1;
-	else return ((int)((unsigned char) maxNoise));
+LidarLiteResult LidarLite::maxNoise(){
+	log<VERBOSE>("LidarLite::maxNoise");
+	int maxNoise = readByte(REG_MAX_NOISE, false);
+	if (maxNoise == -1) return makeResult(-1);
+	else return makeResult((int)((unsigned char) maxNoise));
 }
 
 //--------------------------------------------------------------	
-int LidarLite::correlationPeakValue(){
-	if (logLevel <= VERBOSE) cout << "LidarLite::correlationPeakValue" << endl;
-	int corrPeakVal = readByte(fd, REG_CORR_PEAK_VAL, false);
-	if (corrPeakVal == -1) return -1;
-	else return ((int)((unsigned char) corrPeakVal));
+LidarLiteResult LidarLite::correlationPeakValue(){
+	log<VERBOSE>("LidarLite::correlationPeakValue");
+	int corrPeakVal = readByte(REG_CORR_PEAK_VAL, false);
+	if (corrPeakVal == -1) return makeResult(-1);
+	else return makeResult((int)((unsigned char) corrPeakVal));
 }
 
 //--------------------------------------------------------------	
-int LidarLite::transmitPower(){
-	if (logLevel <= VERBOSE) cout << "LidarLite::transmitPower" << endl;
-	int transPow = readByte(fd, REG_TRANSMIT_POWER, false);
-	if (transPow == -1) return -1;
-	else return ((int)((unsigned char) transPow));
+LidarLiteResult LidarLite::transmitPower(){
+	log<VERBOSE>("LidarLite::transmitPower");
+	int transPow = readByte(REG_TRANSMIT_POWER, false);
+	if (transPow == -1) return makeResult(-1);
+	else return makeResult((int)((unsigned char) transPow));
 }
 
 //--------------------------------------------------------------	
 int LidarLite::eyeSafetyOn(){
-	if (logLevel <= VERBOSE) cout << "LidarLite::eyeSafe" << endl;
+	log<VERBOSE>("LidarLite::eyeSafe");
 	int eyeSafety = -1;
 	int stat = status(); // Read from the Mode/Status register
-	if (logLevel <= VERBOSE) cout << "status = " << stat << endl;
+	log<VERBOSE>("status = ", stat);
 	if (stat != -1) {
 		// If bit8 of stat == 1, eyeSafety is on
 		eyeSafety = (((unsigned char) stat ) & STATUS_EYE_SAFETY_ON);
-		if (logLevel <= VERBOSE) cout << "eyeSafety = " << eyeSafety << endl;
+		log<VERBOSE>("eyeSafety = ", eyeSafety);
 	}
 	return eyeSafety;
 }
 
 //--------------------------------------------------------------	
 int LidarLite::hardwareVersion() {
-	if (logLevel <= VERBOSE) cout << "LidarLite::hardwareVersion" << endl;
+	log<VERBOSE>("LidarLite::hardwareVersion");
 	return hwVersion;
 }
 
 //--------------------------------------------------------------	
 int LidarLite::softwareVersion() {
-	if (logLevel <= VERBOSE) cout << "LidarLite::hardwareVersion" << endl;
+	log<VERBOSE>("LidarLite::softwareVersion");
 	return swVersion;
 }
 
 //--------------------------------------------------------------	
-int LidarLite::status() {
-	if (logLevel <= VERBOSE) cout << "LidarLite::status" << endl;
-	// return the status register result
-	return wiringPiI2CReadReg8(fd, REG_STATUS) ;
+LidarLiteResult LidarLite::status() {
+	log<VERBOSE>("LidarLite::status");
+	// return the status register result, it's also its own status
+	LidarLiteResult result;
+	result.value = bus->readReg8(address, REG_STATUS);
+	result.error = (result.value == -1) ? ERROR_BUS : ERROR_NONE;
+	result.status = result.value;
+	return result;
+}
+
+/* =============================================================================
+  readCorrelationRecord
+  Reads the correlation record behind the last measurement through the memory
+  access port: select the correlation bank, enter test mode, then read
+  register 0x52, which streams two bytes per entry (low byte, then 0x00 or 0xff
+  as the sign). That is a little-endian int16, so the transfers land directly
+  in record.values and only a big-endian host has to swap. Test mode is left
+  again even if a transfer fails.
+  Parameters
+  ------------------------------------------------------------------------------
+  - size (optional): Default: 256, entries to read, clamped to
+    LidarLiteCorrelationRecord::MAX_SIZE
+  Example Usage
+  ------------------------------------------------------------------------------
+      LidarLiteCorrelationRecord record;
+      myLidarLiteInstance.distance();
+      if (myLidarLiteInstance.readCorrelationRecord(record)) {
+          LidarLiteCorrelationPeaks peaks = LidarLiteCorrelation::analyze(record.values, record.size);
+      }
+============================================================================= */
+bool LidarLite::readCorrelationRecord(LidarLiteCorrelationRecord & record, int size) {
+	log<VERBOSE>("LidarLite::readCorrelationRecord size = ", size);
+	record.size = 0;
+	if (size <= 0) return false;
+	if (size > LidarLiteCorrelationRecord::MAX_SIZE) size = LidarLiteCorrelationRecord::MAX_SIZE;
+	
+	// The record belongs to the measurement in progress, if any
+	if (acquisitionPending) {
+		error = waitWhileBusy();
+		if (error != ERROR_NONE) return false;
+	}
+	
+	if (bus->writeReg8(address, REG_MEMORY_BANK, VAL_MEMORY_BANK_CORRELATION) == -1 ||
+		bus->writeReg8(address, REG_TEST_MODE, VAL_TEST_MODE_ON) == -1) {
+		error = ERROR_BUS;
+		return false;
+	}
+	
+	unsigned char * bytes = (unsigned char *) record.values;
+	int total = size * 2;
+	bool success = true;
+	for (int offset = 0; offset < total && success; offset += CORRELATION_TRANSFER_BYTES) {
+		int length = min(CORRELATION_TRANSFER_BYTES, total - offset);
+		success = readBlock(REG_CORRELATION_DATA | REG_AUTO_INCREMENT, bytes + offset, length, false);
+	}
+	Error readError = error;
+	bus->writeReg8(address, REG_TEST_MODE, VAL_TEST_MODE_OFF);
+	error = readError;
+	if (!success) return false;
+	
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+	for (int i = 0; i < size; i++) record.values[i] = (int16_t) ((bytes[2 * i + 1] << 8) | bytes[2 * i]);
+#endif
+	record.size = size;
+	record.timestampNanos = chrono::duration_cast<chrono::nanoseconds>(
+		LidarLiteClock::now().time_since_epoch()).count();
+	record.sequence = 0;
+	return true;
+}
+
+//--------------------------------------------------------------	
+LidarLiteResult LidarLite::makeResult(int value) {
+	LidarLiteResult result;
+	result.value = value;
+	result.error = (value == -1) ? ((error != ERROR_NONE) ? error : ERROR_BUS) : ERROR_NONE;
+	result.status = lastStatus;
+	return result;
 }
 
 //--------------------------------------------------------------	
 string LidarLite::statusString(int statusInt) {
-	stringstream out;
-	
-	if (statusInt == -1) {
-		out << "STATUS: -1 error;";
+	return LidarLiteStatus::text(statusInt);
+}
+
+/* =============================================================================
+  Acquisition timing
+  An acquisition takes a predictable amount of time for a given configuration.
+  Rather than hammering the status register from the moment a measurement is
+  triggered, waitWhileBusy() sleeps through most of the expected acquisition
+  time, then polls the busy flag with a growing back-off until it clears or
+  the busy timeout expires.
+  Parameters
+  ------------------------------------------------------------------------------
+  - micros: acquisition time of the default configuration, configure(1) takes
+    a third of it
+  - dcCorrectionMicros: extra time taken when the preamp is DC stabilized
+  - timeoutMicros: how long after the trigger to give up on the busy flag
+============================================================================= */
+void LidarLite::setAcquisitionTime(int micros, int dcCorrectionMicros) {
+	acquisitionMicros = micros;
+	this->dcCorrectionMicros = dcCorrectionMicros;
+}
+
+//--------------------------------------------------------------	
+void LidarLite::setBusyTimeout(int timeoutMicros) {
+	busyTimeoutMicros = timeoutMicros;
+}
+
+//--------------------------------------------------------------	
+int LidarLite::expectedAcquisitionMicros(bool stablizePreampFlag) {
+	int micros = acquisitionMicros;
+	if (activeConfiguration == 1) micros /= 3;
+	// A velocity measurement is two acquisitions with the pair delay in between, and REG_ACQ_MODE
+	// = VAL_ACQ_MODE_VELOCITY leaves the default acquisition count bit clear
+	if (velocityMode) micros = 2 * (acquisitionMicros / 3) + velocityScale * MEASURE_DELAY_MICROS_PER_COUNT;
+	if (stablizePreampFlag) micros += dcCorrectionMicros;
+	return micros;
+}
+
+/* =============================================================================
+  Adaptive stabilization
+  DC stabilization makes every acquisition slower but is only needed now and
+  then (1 out of every 100 readings is typically good). With the adaptive
+  policy enabled a requested stabilization is only done when:
+  ------------------------------------------------------------------------------
+  1.  interval measurements have passed since the last one
+  2.  the running average of maxNoise drifted more than noiseDrift from its
+      value right after the last one, e.g. as the sensor warms up (only seen by measure() and
+      readMeasurement(), distance() doesn't read maxNoise)
+  3.  the last measurement reported STATUS_SIGNAL_INVALID
+  All other measurements are taken with VAL_MEASURE_NO_DC_CRCT. The first
+  measurement after enabling is always stabilized.
+  Example Usage
+  ------------------------------------------------------------------------------
+      myLidarLite.setAdaptiveStabilization(true);
+      while (true) {
+          int d = myLidarLite.distance();	// DC stabilized when due
+      }
+============================================================================= */
+void LidarLite::setAdaptiveStabilization(bool enabled, int interval, int noiseDrift) {
+	adaptiveStabilization = enabled;
+	stabilizationInterval = (interval > 0) ? interval : 1;
+	stabilizationNoiseDrift = noiseDrift;
+	measurementsSinceStabilization = 0;
+	noiseAverage = -1;
+	referenceNoise = -1;
+	stabilizationRequested = true;
+}
+
+//--------------------------------------------------------------	
+void LidarLite::setStats(shared_ptr<LidarLiteStats> stats) {
+	statistics = stats;
+}
+
+//--------------------------------------------------------------	
+shared_ptr<LidarLiteStats> LidarLite::getStats() {
+	return statistics;
+}
+
+//--------------------------------------------------------------	
+unsigned long LidarLite::stabilizationCount() {
+	return stabilizations;
+}
+
+//--------------------------------------------------------------	
+bool LidarLite::stabilizeNow(bool stablizePreampFlag) {
+	if (stablizePreampFlag && adaptiveStabilization) {
+		stablizePreampFlag = stabilizationRequested || measurementsSinceStabilization + 1 >= stabilizationInterval;
+	}
+	if (stablizePreampFlag) {
+		measurementsSinceStabilization = 0;
+		stabilizationRequested = false;
+		stabilizations++;
 	} else {
-		unsigned char stat = (unsigned char) statusInt;
+		measurementsSinceStabilization++;
+	}
+	lastAcquisitionStabilized = stablizePreampFlag;
+	return stablizePreampFlag;
+}
+
+//--------------------------------------------------------------	
+void LidarLite::noteResult(int status, int maxNoise, bool stabilized) {
+	if (!adaptiveStabilization) return;
+	
+	// Average out the reading-to-reading jitter of maxNoise, only a sustained shift counts
+	if (maxNoise >= 0) {
+		noiseAverage = (noiseAverage < 0) ? maxNoise : noiseAverage + (maxNoise - noiseAverage) / 8.f;
+	}
+	
+	if (stabilized) {
+		// Fresh baseline. If even a stabilized measurement sees no signal,
+		// stabilizing again won't help, wait for the interval.
+		referenceNoise = noiseAverage;
+		return;
+	}
+	// Pipelined, the acquisition after this one may already be stabilizing
+	if (lastAcquisitionStabilized) return;
+	if (status != -1 && (((unsigned char) status) & STATUS_SIGNAL_INVALID) != 0) {
+		stabilizationRequested = true;
+	}
+	if (noiseAverage >= 0 && referenceNoise >= 0 && stabilizationNoiseDrift > 0 &&
+		fabs(noiseAverage - referenceNoise) > stabilizationNoiseDrift) {
+		stabilizationRequested = true;
+	}
+}
+
+//--------------------------------------------------------------	
+LidarLite::Error LidarLite::lastError() {
+	return error;
+}
+
+//--------------------------------------------------------------	
+int LidarLite::startAcquisition(bool stablizePreampFlag) {
+	LidarLiteStats * stats = statistics.get();
+	int writeSuccess;
+	{
+		LidarLiteStageTimer timer(stats, LidarLiteStats::STAGE_TRIGGER);
+		writeSuccess = bus->writeReg8(address, REG_MEASURE, 
+			stablizePreampFlag ? VAL_MEASURE : VAL_MEASURE_NO_DC_CRCT);
+	}
+	if (stats) {
+		stats->count(LidarLiteStats::COUNTER_MEASUREMENTS);
+		if (writeSuccess == -1) stats->count(LidarLiteStats::COUNTER_BUS_ERRORS);
+	}
+	acquisitionPending = true;
+	acquisitionStart = LidarLiteClock::now();
+	acquisitionDueMicros = expectedAcquisitionMicros(stablizePreampFlag);
+	return writeSuccess;
+}
+
+/* =============================================================================
+  waitWhileBusy
+  Blocks until the busy flag clears. Returns ERROR_NONE once the sensor is
+  idle, or ERROR_BUSY_TIMEOUT if it stays busy past the busy timeout.
+  Process
+  ------------------------------------------------------------------------------
+  1.  If an acquisition was just triggered, sleep until ~80% of its expected
+      duration has passed. The status register is not touched meanwhile.
+  2.  Poll the status register. v1 hardware NAKs while busy, which reads as -1
+      and is treated the same as the busy bit.
+  3.  Between polls sleep, starting at 1/16 of the expected acquisition time
+      and doubling up to 1ms, so a late sensor is not polled flat out.
+============================================================================= */
+LidarLite::Error LidarLite::waitWhileBusy() {
+	LidarLiteStats * stats = statistics.get();
+	LidarLiteStageTimer timer(stats, LidarLiteStats::STAGE_BUSY_WAIT);
+	LidarLiteClock::time_point start = acquisitionPending ? acquisitionStart : LidarLiteClock::now();
+	// The velocity pair delay is deliberate idle time, not the sensor being slow
+	int timeoutMicros = busyTimeoutMicros + (velocityMode ? velocityScale * MEASURE_DELAY_MICROS_PER_COUNT : 0);
+	LidarLiteClock::time_point deadline = start + chrono::microseconds(timeoutMicros);
+	
+	int backoffMicros = MIN_POLL_BACKOFF_MICROS;
+	if (acquisitionPending) {
+		LidarLiteClock::time_point wake = start + chrono::microseconds(acquisitionDueMicros * 4 / 5);
+		LidarLiteClock::time_point now = LidarLiteClock::now();
+		if (wake > now) usleep((useconds_t) chrono::duration_cast<chrono::microseconds>(wake - now).count());
+		backoffMicros = max(MIN_POLL_BACKOFF_MICROS, acquisitionDueMicros / 16);
+	}
+	
+	while (true) {
+		int stat;
+		{
+			LidarLiteStageTimer pollTimer(stats, LidarLiteStats::STAGE_STATUS_POLL);
+			stat = status(); // Read from the Mode/Status register
+		}
+		if (stats) stats->count(LidarLiteStats::COUNTER_STATUS_POLLS);
+		log<VERBOSE>("status = ", stat);
+		// If bit0 of stat == 1, the LIDAR Lite is busy
+		if (stat != -1 && (((unsigned char) stat ) & STATUS_BUSY) == 0) {
+			lastStatus = stat;
+			acquisitionPending = false;
+			return ERROR_NONE;
+		}
 		
-		// Print the hex status byte
-		out << "STATUS BYTE: 0x";
-		out << setw(2) << setfill('0') << hex << (int) stat;
-
-		if (stat & STATUS_BUSY) out << " busy;";              
-		if (stat & STATUS_REFERENCE_OVERFLOW) out << " reference overflow;";            
-		if (stat & STATUS_SIGNAL_OVERFLOW) out << " signal overflow;";            
-		if (stat & STATUS_PIN) out << " mode select pin;";                 
-		if (stat & STATUS_SECOND_PEAK) out << " second peak;";         
-		if (stat & STATUS_TIMESTAMP) out << " active between pairs;";                
-		if (stat & STATUS_SIGNAL_INVALID) out << " no signal;";             
-		if (stat & STATUS_EYE_SAFETY_ON) out << " eye safety;";  	
-	}
-	return out.str();
-}  
-
-//--------------------------------------------------------------	
-int LidarLite::readByte(int fd, int reg, bool monitorBusyFlag) {
-	if (logLevel <= VERBOSE) cout << "LidarLite::readByte" << endl;
-	int busyFlag = 0;
-    if(monitorBusyFlag){
-    busyFlag = 1;
-    }
-    int busyCounter = 0;
-    while(busyFlag != 0){
-        int stat = status(); // Read from the Mode/Status register
-        if (logLevel <= VERBOSE) cout << "status = " << stat << endl;
-        if (stat != -1) {
-            // If bit0 of stat == 1, the LIDAR Lite is busy
-            busyFlag = (((unsigned char) stat ) & STATUS_BUSY);
-            if (logLevel <= VERBOSE) cout << "busyFlag = " << busyFlag << endl;
-        }
-
-        busyCounter++;
-        if(busyCounter > 9999){
-          if(errorReporting){
-                    // errorReporting not yet supported, come again soon
-                    cout << "errorReporting not yet supported, come again soon" << endl;
-          }
-                // Soooo busy, need to bail
-                busyCounter = 0;
-                cout << "> Bailout" << endl;
-          break;
-        }
-    }
-    if(busyFlag == 0){
-		if (hardwareVersion() < 21) usleep(1000); //ofSleepMillis(1); 
+		LidarLiteClock::time_point now = LidarLiteClock::now();
+		if (now >= deadline) {
+			// Keep what the sensor last said, busy bit and all
+			lastStatus = stat;
+			acquisitionPending = false;
+			if (stats) stats->count(LidarLiteStats::COUNTER_BUSY_TIMEOUTS);
+			return ERROR_BUSY_TIMEOUT;
+		}
 		
-		int output = wiringPiI2CReadReg8(fd, reg);
-		if (hardwareVersion() < 21) {
-			// Attempt to get LidarLite V1 working with new V2 code
-			int i = 0;
-			while (true) {
-				if (output == -1) {
-					// output 
-					//ofSleepMillis(20);
-					usleep(20000); 
-					output = wiringPiI2CReadReg8(fd, reg);
-					if (i++ > 20) { // Originally 50
-						// Timeout
-						if (logLevel <= INFO) cout << "Timeout" << endl;
-						return -1;
-					}
-				} else {
-					break;
+		LidarLiteClock::time_point wake = now + chrono::microseconds(backoffMicros);
+		if (wake > deadline) wake = deadline;
+		usleep((useconds_t) chrono::duration_cast<chrono::microseconds>(wake - now).count());
+		backoffMicros = min(backoffMicros * 2, MAX_POLL_BACKOFF_MICROS);
+	}
+}
+
+//--------------------------------------------------------------	
+int LidarLite::readByte(int reg, bool monitorBusyFlag) {
+	log<VERBOSE>("LidarLite::readByte");
+	if (monitorBusyFlag) {
+		error = waitWhileBusy();
+		if (error != ERROR_NONE) {
+			if(errorReporting){
+				// errorReporting not yet supported, come again soon
+				log<WARN>("errorReporting not yet supported, come again soon");
+			}
+			// Soooo busy, need to bail
+			log<WARN>("> Bailout");
+			if (statistics) statistics->count(LidarLiteStats::COUNTER_BAILOUTS);
+			return -1;
+		}
+	}
+	
+	LidarLiteStats * stats = statistics.get();
+	LidarLiteStageTimer v1Timer((hardwareVersion() < 21) ? stats : NULL, LidarLiteStats::STAGE_V1_WORKAROUND);
+	if (hardwareVersion() < 21) usleep(1000); //ofSleepMillis(1); 
+	
+	int output;
+	{
+		LidarLiteStageTimer timer(stats, LidarLiteStats::STAGE_REGISTER_READ);
+		output = bus->readReg8(address, reg);
+	}
+	if (hardwareVersion() < 21) {
+		// Attempt to get LidarLite V1 working with new V2 code
+		int i = 0;
+		while (true) {
+			if (output == -1) {
+				// output 
+				//ofSleepMillis(20);
+				usleep(20000); 
+				output = bus->readReg8(address, reg);
+				if (stats) stats->count(LidarLiteStats::COUNTER_V1_RETRIES);
+				if (i++ > 20) { // Originally 50
+					// Timeout
+					log<INFO>("Timeout");
+					error = ERROR_BUS;
+					if (stats) stats->count(LidarLiteStats::COUNTER_BUS_ERRORS);
+					return -1;
 				}
+			} else {
+				break;
 			}
 		}
-		return output;
-		
-  } else {
-		return -1;
 	}
-}			
-		
+	error = (output == -1) ? ERROR_BUS : ERROR_NONE;
+	if (stats && output == -1) stats->count(LidarLiteStats::COUNTER_BUS_ERRORS);
+	return output;
+}
 
-	
\ No newline at end of file
+//--------------------------------------------------------------	
+bool LidarLite::readBlock(int reg, unsigned char * buffer, int length, bool monitorBusyFlag) {
+	log<VERBOSE>("LidarLite::readBlock");
+	if (monitorBusyFlag) {
+		error = waitWhileBusy();
+		if (error != ERROR_NONE) {
+			log<WARN>("> Bailout");
+			if (statistics) statistics->count(LidarLiteStats::COUNTER_BAILOUTS);
+			return false;
+		}
+	}
+	
+	LidarLiteStats * stats = statistics.get();
+	LidarLiteStageTimer v1Timer((hardwareVersion() < 21) ? stats : NULL, LidarLiteStats::STAGE_V1_WORKAROUND);
+	if (hardwareVersion() < 21) usleep(1000);
+	
+	int output;
+	{
+		LidarLiteStageTimer timer(stats, LidarLiteStats::STAGE_REGISTER_READ);
+		output = bus->readBlock(address, reg, buffer, length);
+	}
+	if (hardwareVersion() < 21) {
+		// LidarLite V1 may NAK for a while after the busy flag clears
+		for (int i = 0; output == -1 && i <= 20; i++) {
+			usleep(20000);
+			output = bus->readBlock(address, reg, buffer, length);
+			if (stats) stats->count(LidarLiteStats::COUNTER_V1_RETRIES);
+		}
+	}
+	error = (output == -1) ? ERROR_BUS : ERROR_NONE;
+	if (stats && output == -1) stats->count(LidarLiteStats::COUNTER_BUS_ERRORS);
+	return (output != -1);
+}
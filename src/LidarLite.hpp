@@ -7,12 +7,11 @@ This work is licensed under the Creative Commons
 Attribution-ShareAlike 3.0 Unported License. 
 To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
 
-Leverages WiringPi by drogon
 Derived from https://github.com/PulsedLight3D/LIDARLite_v2_Arduino_Library/tree/master/LIDARLite
 	
 Requirements:
-	Install wiring pi - http://wiringpi.com/
-	Add PROJECT_LDFLAGS += -lwiringPi to the PROJECT LINKER FLAGS section of config.make
+	Enable the Linux i2c-dev driver (see README.md), or inject a LidarLiteSimulator
+	with setBus() to run without a sensor attached.
 	
 See LIDAR Lite documentation for more info
 http://kb.pulsedlight3d.com/
@@ -21,9 +20,41 @@ https://github.com/PulsedLight3D/
 
 #pragma once
 
+#include "LidarLiteI2cBus.hpp"
+#include "LidarLiteModePin.hpp"
+#include "LidarLiteLog.hpp"
+#include "LidarLiteStats.hpp"
 #include <string>
+#include <memory>
+#include <chrono>
 using namespace std;
 
+// Result registers of one acquisition, fetched in a single I2C transaction by LidarLite::measure()
+struct LidarLiteMeasurement
+{
+	int distance;				// cm
+	int signalStrength;			// 0-255
+	int maxNoise;				// Maximum noise within correlation record, scaled by 1.25
+	int correlationPeakValue;	// Correlation peak, scaled to 0-255
+	int status;					// Status byte seen when the busy flag cleared
+	int velocity;				// cm/s from the on-chip velocity register, 0 unless in velocity mode
+};
+
+// A measurement as delivered by an acquisition thread
+struct LidarLiteSample
+{
+	int distance;						// cm, after filtering (see LidarLiteReader::setFilter), -1 if rejected
+	int rawDistance;					// cm, as read from the LidarLite
+	int signalStrength;					// 0-255
+	int status;							// Status byte, -1 if not read
+	int velocity;						// cm/s, 0 unless in velocity mode
+	unsigned long long timestampNanos;	// steady_clock (monotonic) time the result was read
+	unsigned int sequence;				// Increments per sample, gaps mean samples were dropped
+};
+
+struct LidarLiteResult;
+struct LidarLiteCorrelationRecord;
+
 class LidarLite 
 {
 	public:
@@ -37,7 +68,14 @@ class LidarLite
 		static const unsigned char STATUS_SIGNAL_INVALID = 0x40;	// Signal Invalid – “1” No signal detected, “0’ signal detected.
 		static const unsigned char STATUS_EYE_SAFETY_ON = 0x80;	// Indicates that eye safety average power limit has been exceeded and power reduction is in place.
 		
-		int logLevel;		// Toggles on and off cout debug messages
+		// Velocity scaling for startVelocity(): the delay between the two measurements of a pair,
+		// which sets the velocity resolution (1cm of change over the delay)
+		static const unsigned char VELOCITY_SCALE_0_10_MPS = 0xc8;	// 100ms between measurements, 0.10 m/s per count
+		static const unsigned char VELOCITY_SCALE_0_25_MPS = 0x50;	// 40ms, 0.25 m/s per count
+		static const unsigned char VELOCITY_SCALE_0_50_MPS = 0x28;	// 20ms, 0.50 m/s per count
+		static const unsigned char VELOCITY_SCALE_1_00_MPS = 0x14;	// 10ms, 1.00 m/s per count
+		
+		int logLevel;		// Runtime log threshold, levels below LIDARLITE_MIN_LOG_LEVEL are compiled out (see LidarLiteLog.hpp)
 		static const int VERBOSE = 2;
 		static const int DEBUG = 3;
 		static const int INFO = 4;
@@ -46,8 +84,20 @@ class LidarLite
 		static const int ASSERT = 7;
 		static const int NONE = 8;
 		
+		// Error categories reported by lastError()
+		enum Error {
+			ERROR_NONE = 0,			// Last access succeeded
+			ERROR_BUS,				// The I2C transaction failed (NAK or adapter error)
+			ERROR_BUSY_TIMEOUT		// The busy flag did not clear before the busy timeout
+		};
+		
 		// Constructor
 		LidarLite();					
+		LidarLite(shared_ptr<LidarLiteI2cBus> bus);
+		
+		// Select the I2C transport, defaults to /dev/i2c-1 if not set before begin()
+		void setBus(shared_ptr<LidarLiteI2cBus> bus);
+		shared_ptr<LidarLiteI2cBus> getBus();
 		
 		// Initialize the LidarLite
 		void begin(int configuration = 0, bool fasti2c = false, bool showErrorReporting = false, char LidarLiteI2cAddress = 0x62);
@@ -55,44 +105,207 @@ class LidarLite
 		// Returns whether or not the LidarLite was successfully initialized
 		bool hasBegun();			
 		
-		// configure the LidarLite
+		// configure the LidarLite and wait until it is ready again
 		void configure(int configuration = 0);
 		
+		// Readiness-based startup, for bringing up many sensors at once (see LidarLiteArray):
+		bool identify(unsigned char LidarLiteI2cAddress = 0x62,	// Wait for the sensor to answer, read its versions
+			int timeoutMicros = DEFAULT_READY_TIMEOUT_MICROS);
+		bool startConfigure(int configuration = 0);	// Write the configuration and return immediately
+		int pollReady();							// 1 if ready, 0 if still busy, -1 past the deadline
+		bool waitUntilReady();						// Poll until ready or past the deadline
+		int timeToReadyMicros();					// From begin()/identify() to ready after configuring, -1 if not ready
+		
 		// Read the distance on the LidarLite
-		int distance(bool stablizePreampFlag = true, bool takeReference = true); 
+		LidarLiteResult distance(bool stablizePreampFlag = true, bool takeReference = true); 
+		
+		// Take a measurement and read distance, signal strength, noise and correlation peak in one transaction.
+		// Returns false if the sensor stayed busy or the bus failed, see lastError()
+		bool measure(LidarLiteMeasurement & measurement, bool stablizePreampFlag = true);
+		
+		// Pipelined measurement: returns the result of the measurement started by the previous call (starting
+		// one first if none is in flight) and starts the next one as soon as that finishes, so the sensor
+		// measures during the readout and while the caller works on this result. endPipeline() waits out the
+		// measurement in flight; the other measuring calls end the pipeline themselves.
+		bool measurePipelined(LidarLiteMeasurement & measurement, bool stablizePreampFlag = true);
+		void endPipeline();
+		bool isPipelined();
+		
+		// Split-phase measurement, for driving several LidarLites at once (see LidarLiteArray)
+		bool trigger(bool stablizePreampFlag = true);	// Start a measurement and return immediately
+		chrono::steady_clock::time_point expectedCompletion();	// When the triggered measurement should finish
+		int pollCompletion();							// 1 if finished, 0 if still busy, -1 on busy timeout or bus error
+		bool readMeasurement(LidarLiteMeasurement & measurement);	// Read the results once pollCompletion() returned 1
+		
+		// Reprogram the I2C address (lost on power cycle). Optionally stop answering on the old address.
+		bool changeAddress(unsigned char newAddress, bool disablePrimaryAddress = true);
+		
+		// I2C address this LidarLite talks to
+		unsigned char getAddress();
+		
+		// Put the LidarLite in free-running mode, measuring on its own at up to rateHz (max ~500)
+		bool startContinuous(int rateHz, bool stablizePreampFlag = true);
+		
+		// Return to host-triggered measurements
+		void stopContinuous();
+		
+		// Returns whether the LidarLite is in free-running mode
+		bool isContinuous();
+		
+		// Put the LidarLite in velocity mode: every measurement is a pair of acquisitions scale * 0.5ms
+		// apart, and measure() also returns the on-chip velocity (see LidarLiteMeasurement::velocity)
+		bool startVelocity(unsigned char scale = VELOCITY_SCALE_0_10_MPS);
+		
+		// Return to distance-only measurements
+		void stopVelocity();
+		
+		// Returns whether the LidarLite is in velocity mode
+		bool isVelocityMode();
+		
+		// GPIO wired to the MODE pin; in free-running mode results are read on its edges instead of on a timer
+		void setModePin(shared_ptr<LidarLiteModePin> pin);
+		
+		// Waits for the next free-running result and reads it
+		bool readContinuous(LidarLiteMeasurement & measurement);
 		
 		// Read the signal strength of the lidarLite
-		int signalStrength();
+		LidarLiteResult signalStrength();
 		
 		// Maximum noise within correlation record [Read Only]: scaled by 1.25 (typically between 0x10–0x30)
-		int maxNoise();
+		LidarLiteResult maxNoise();
 		
 		// Correlation Peak value of signal correlation [Read Only]: (scaled to 0 – 0xff max peak value)
-		int correlationPeakValue();
+		LidarLiteResult correlationPeakValue();
 		
 		// Returns whether or not eye safety has been activated
 		int eyeSafetyOn();
 		
 		// Returns transmit power of LidarLite
-		int transmitPower();
+		LidarLiteResult transmitPower();
 		
 		// Get the status of the LidarLite
-		int status();		
+		LidarLiteResult status();		
 		
-		// Returns a human readable string describing the status
+		// Read the raw correlation record of the last measurement (see LidarLiteCorrelation), size entries
+		// up to LidarLiteCorrelationRecord::MAX_SIZE, in transfers of up to CORRELATION_TRANSFER_BYTES
+		bool readCorrelationRecord(LidarLiteCorrelationRecord & record, int size = 256);
+		
+		// Returns a human readable string describing the status (LidarLiteStatus::text doesn't allocate)
 		static string statusString(int status);
 					
 		int hardwareVersion();	// Get the Hardware Version of the LidarLite
 		int softwareVersion();	// Get the Hardware Version of the LidarLite
 		
+		// Returns the error category of the last register read
+		Error lastError();
+		
+		// Tune the expected acquisition time used to sleep instead of polling the busy flag
+		void setAcquisitionTime(int micros, int dcCorrectionMicros);
+		
+		// Give up on the busy flag this long after a measurement is triggered
+		void setBusyTimeout(int timeoutMicros);
+		
+		// Expected duration of an acquisition in the active configuration
+		int expectedAcquisitionMicros(bool stablizePreampFlag = true);
+		
+		// Stabilize the preamp only when needed instead of on every measurement: every interval
+		// measurements, when the average maxNoise drifts by more than noiseDrift from its value after
+		// the last stabilization (0 to ignore), and after an invalid signal. While enabled, stablizePreampFlag
+		// = true lets this policy decide and false still never stabilizes.
+		void setAdaptiveStabilization(bool enabled, int interval = 100, int noiseDrift = 8);
+		
+		// Number of measurements taken with DC stabilization, to check the adaptive policy
+		unsigned long stabilizationCount();
+		
+		// Collect per-stage latencies and error counters, pass an empty pointer to stop.
+		// Not thread safe, set it while no measurement is in progress.
+		void setStats(shared_ptr<LidarLiteStats> stats);
+		shared_ptr<LidarLiteStats> getStats();
+		
+	protected:
+		// The attached stats for instrumenting subclasses, NULL if none
+		LidarLiteStats * activeStats() { return statistics.get(); }
+		
 	private:
-		int fd;									// file descriptor for I2C interface
+		shared_ptr<LidarLiteI2cBus> bus;		// I2C transport, possibly shared with other LidarLites
+		unsigned char address;					// I2C address of this LidarLite
 		bool errorReporting;		// Not yet implemented
 		int hwVersion;					// Stores the Hardware version to avoid repeated device polling
 		int swVersion;					// Stores the Software version to avoid repeated device polling
 		
+		Error error;							// Error category of the last register read
+		int lastStatus;							// Status byte read when the busy flag last cleared
+		int activeConfiguration;				// Last configure() setting that changed the acquisition count
+		int acquisitionMicros;					// Expected acquisition time in the default configuration
+		int dcCorrectionMicros;					// Extra acquisition time with DC stabilization
+		int busyTimeoutMicros;					// Deadline for the busy flag to clear
+		bool acquisitionPending;				// Whether a measurement was triggered and not yet waited on
+		chrono::steady_clock::time_point acquisitionStart;	// When the pending measurement was triggered
+		int acquisitionDueMicros;				// Expected duration of the pending measurement
+		shared_ptr<LidarLiteModePin> modePin;	// Optional measurement-complete edge source
+		bool continuous;						// Whether free-running mode is active
+		int continuousPeriodMicros;				// Free-running measurement period
+		chrono::steady_clock::time_point continuousNextRead;	// When to read the next result without a mode pin
+		bool readyPending;						// Whether the sensor is booting or applying a configuration
+		chrono::steady_clock::time_point readyStart;	// When begin()/identify() started
+		chrono::steady_clock::time_point readyDeadline;	// Give up on readiness at this time
+		int readyMicros;						// Time to ready, -1 if not (yet) ready
+		bool velocityMode;						// Whether startVelocity() is active
+		bool pipelined;							// Whether measurePipelined() left a measurement in flight
+		int pipelineReadoutMicros;				// Duration of the last pipelined result readout, -1 if unknown
+		unsigned char velocityScale;			// REG_VELOCITY_SCALE counts between the measurement pair
+		bool adaptiveStabilization;				// Whether stabilizeNow() applies the policy below
+		int stabilizationInterval;				// Stabilize at least every this many measurements
+		int stabilizationNoiseDrift;			// maxNoise change forcing a stabilization, 0 = ignore
+		int measurementsSinceStabilization;
+		float noiseAverage;						// Running average of maxNoise, -1 until read
+		float referenceNoise;					// noiseAverage right after the last stabilization, -1 if unknown
+		bool stabilizationRequested;			// Set by noteResult() on drift or invalid signal
+		bool lastAcquisitionStabilized;			// Flag of the most recently triggered acquisition
+		unsigned long stabilizations;
+		shared_ptr<LidarLiteStats> statistics;	// Optional instrumentation, see setStats()
+		
 		// readByte does the register reading heavy lifting
-		int readByte(int fd, int reg, bool monitorBusyFlag); 	
+		int readByte(int reg, bool monitorBusyFlag); 	
+		
+		// readBlock reads consecutive registers in one transaction, returns false on error
+		bool readBlock(int reg, unsigned char * buffer, int length, bool monitorBusyFlag);
+		
+		// Reads the result registers of the last completed measurement into measurement,
+		// stabilized telling whether that measurement ran with DC stabilization
+		bool readResult(LidarLiteMeasurement & measurement, bool monitorBusyFlag, bool stabilized);
+		
+		// Starts the next pipelined measurement, ending the pipeline if the trigger fails
+		void triggerNext(bool stablizePreampFlag);
+		
+		// Packs value with the current error and the status seen by the last busy wait
+		LidarLiteResult makeResult(int value);
+		
+		// Applies the adaptive stabilization policy to a requested stablizePreampFlag
+		bool stabilizeNow(bool stablizePreampFlag);
+		
+		// Feeds a completed measurement to the adaptive stabilization policy, maxNoise -1 if not read
+		void noteResult(int status, int maxNoise, bool stabilized);
+		
+		// Triggers a measurement and records when it should complete
+		int startAcquisition(bool stablizePreampFlag);
+		
+		// Sleeps then polls until the busy flag clears or the busy timeout expires
+		Error waitWhileBusy();
+		
+		// Log message (a string literal) with up to two values, compiled out below LIDARLITE_MIN_LOG_LEVEL
+		template <int Level>
+		void log(const char * message) {
+			LidarLiteLogDispatch<LidarLiteLogEnabled<Level>::value>::log(logLevel, Level, message, 0, 0, 0);
+		}
+		template <int Level>
+		void log(const char * message, int value) {
+			LidarLiteLogDispatch<LidarLiteLogEnabled<Level>::value>::log(logLevel, Level, message, 1, value, 0);
+		}
+		template <int Level>
+		void log(const char * message, int value0, int value1) {
+			LidarLiteLogDispatch<LidarLiteLogEnabled<Level>::value>::log(logLevel, Level, message, 2, value0, value1);
+		}
 		
 		unsigned char REG_STATUS;
 		
@@ -108,11 +321,61 @@ class LidarLite
 		static const unsigned char REG_MAX_NOISE = 0x0d;
 		static const unsigned char REG_CORR_PEAK_VAL = 0x0c;
 		static const unsigned char REG_TRANSMIT_POWER = 0x0c;
+		static const unsigned char REG_AUTO_INCREMENT = 0x80;	// OR into a register to auto-increment on multi-byte reads
+		static const unsigned char REG_ACQ_MODE = 0x04;
+		static const unsigned char REG_OUTER_LOOP_COUNT = 0x11;
+		static const unsigned char REG_MEASURE_DELAY = 0x45;
+		static const unsigned char REG_VELOCITY_SCALE = 0x68;	// Delay between a velocity measurement pair
+		static const unsigned char REG_SERIAL_NUMBER = 0x16;		// 2 bytes, high then low
+		static const unsigned char REG_SERIAL_CHECK_HI = 0x18;
+		static const unsigned char REG_SERIAL_CHECK_LO = 0x19;
+		static const unsigned char REG_NEW_ADDRESS = 0x1a;
+		static const unsigned char REG_ADDRESS_CONTROL = 0x1e;
+		static const unsigned char REG_VELOCITY = 0x09;			// Signed cm between the measurement pair
+		static const unsigned char REG_TEST_MODE = 0x40;
+		static const unsigned char REG_MEMORY_BANK = 0x5d;
+		static const unsigned char REG_CORRELATION_DATA = 0x52;	// 2 bytes per entry in test mode, little endian
 		
 		// Write values
 		static const unsigned char VAL_MEASURE = 0x04;
 		static const unsigned char VAL_MEASURE_NO_DC_CRCT = 0x03;
+		static const unsigned char VAL_ACQ_MODE_DEFAULT = 0x08;
+		static const unsigned char VAL_ACQ_MODE_HIGH_SPEED = 0x00;
+		static const unsigned char VAL_ACQ_MODE_USE_DELAY = 0x20;	// Use REG_MEASURE_DELAY between free-running measurements
+		static const unsigned char VAL_ACQ_MODE_VELOCITY = 0xa0;	// Velocity measurement pairs, REG_VELOCITY_SCALE apart
+		static const unsigned char VAL_LOOP_FOREVER = 0xff;
+		static const unsigned char VAL_DISABLE_PRIMARY_ADDRESS = 0x08;
+		static const unsigned char VAL_TEST_MODE_ON = 0x07;
+		static const unsigned char VAL_TEST_MODE_OFF = 0x00;
+		static const unsigned char VAL_MEMORY_BANK_CORRELATION = 0xc0;
+		static const int CORRELATION_TRANSFER_BYTES = 256;		// Largest single read of the correlation record
+		static const int MEASURE_DELAY_MICROS_PER_COUNT = 500;
+		
+		// Acquisition timing defaults, approximate for LIDAR Lite v2
+		static const int DEFAULT_ACQUISITION_MICROS = 6000;
+		static const int DEFAULT_DC_CORRECTION_MICROS = 1500;
+		static const int DEFAULT_BUSY_TIMEOUT_MICROS = 100000;
+		static const int DEFAULT_READY_TIMEOUT_MICROS = 200000;	// For booting or resetting
+		static const int MIN_POLL_BACKOFF_MICROS = 50;
+		static const int MAX_POLL_BACKOFF_MICROS = 1000;
 };
 
+// What an accessor read and how it went, so a failure can be told apart (and
+// a bad sample dropped) without another I2C transaction. Converts to int as the
+// plain value, -1 on error, so `int d = myLidarLite.distance();` still works.
+struct LidarLiteResult
+{
+	int value;					// Register value, -1 on error
+	LidarLite::Error error;		// Why value is -1, ERROR_NONE otherwise
+	int status;					// Status byte seen when the busy flag last cleared, -1 if unknown
 	
-	
\ No newline at end of file
+	operator int() const { return value; }
+	
+	// The read succeeded
+	bool ok() const { return error == LidarLite::ERROR_NONE; }
+	
+	// The read succeeded and the status doesn't flag the measurement as having no signal
+	bool isValid() const {
+		return ok() && (status == -1 || (status & LidarLite::STATUS_SIGNAL_INVALID) == 0);
+	}
+};
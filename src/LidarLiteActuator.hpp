@@ -0,0 +1,33 @@
+/*
+LidarLiteActuator - Pan/tilt mount a LidarLiteScanner points the sensor with
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Hobby servos take an angle and give no feedback, so the scanner commands an
+angle, waits the time the mount says the move takes, and tags each sample
+with the commanded angle. Pan turns about the vertical axis, positive to the
+left; tilt is the elevation, positive up. Both in degrees, 0/0 straight ahead.
+
+Implementations:
+	- LidarLiteSimulatedActuator: a mount with a fixed slew rate that moves a
+	  LidarLiteSimulator target around a scene
+*/
+
+#pragma once
+
+class LidarLiteActuator
+{
+	public:
+		virtual ~LidarLiteActuator() {}
+
+		// Starts a move to the given angles and returns without waiting for it.
+		// Returns false if the command couldn't be sent.
+		virtual bool moveTo(float panDegrees, float tiltDegrees) = 0;
+
+		// Microseconds from commanding a move of this size until the mount is steady enough to measure
+		virtual int settleMicros(float panDeltaDegrees, float tiltDeltaDegrees) = 0;
+};
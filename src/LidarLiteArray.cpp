@@ -0,0 +1,214 @@
+/*
+LidarLiteArray - Drives many LIDAR Lites on one or more I2C buses
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteArray.hpp"
+#include "LidarLiteLinuxI2cBus.hpp"
+#include <algorithm>
+#include <thread>
+#include <unistd.h>
+
+//--------------------------------------------------------------
+LidarLiteArray::LidarLiteArray() {
+}
+
+//--------------------------------------------------------------
+int LidarLiteArray::addBus(int adapter) {
+	return addBus(shared_ptr<LidarLiteI2cBus>(new LidarLiteLinuxI2cBus(adapter)));
+}
+
+//--------------------------------------------------------------
+int LidarLiteArray::addBus(shared_ptr<LidarLiteI2cBus> bus) {
+	buses.push_back(bus);
+	return (int) buses.size() - 1;
+}
+
+//--------------------------------------------------------------
+int LidarLiteArray::addSensor(int bus, unsigned char address, std::function<void(bool)> powerEnable) {
+	if (bus < 0 || bus >= (int) buses.size()) return -1;
+	Sensor sensor;
+	sensor.lidar = shared_ptr<LidarLite>(new LidarLite(buses[bus]));
+	sensor.bus = bus;
+	sensor.address = address;
+	sensor.powerEnable = powerEnable;
+	sensor.ready = false;
+	sensors.push_back(sensor);
+	return (int) sensors.size() - 1;
+}
+
+/* =============================================================================
+  begin
+  Process
+  ------------------------------------------------------------------------------
+  1.  Switch off every sensor that has a power enable line, so that none of
+      them answers on the default 0x62 address
+  2.  One at a time, power each of them up, wait until it answers at 0x62 and
+      move it to its assigned address
+  3.  Wait for the sensors without power enable lines to answer at their address
+  4.  Write the configuration to every sensor back to back, then poll them all
+      until each reports ready, so the resets run concurrently. Configuration 0
+      is a full reset, which would drop a programmed address, so it is skipped
+      for sensors not on 0x62; the ones moved in step 2 have just powered up
+      and are in their default state anyway.
+  No step sleeps a fixed time, see timeToReadyMicros() for how long each
+  sensor took.
+============================================================================= */
+int LidarLiteArray::begin(int configuration) {
+	for (size_t i = 0; i < sensors.size(); i++) {
+		if (sensors[i].powerEnable) sensors[i].powerEnable(false);
+	}
+	
+	for (size_t i = 0; i < sensors.size(); i++) {
+		Sensor & s = sensors[i];
+		if (s.powerEnable) {
+			s.powerEnable(true);
+			s.ready = s.lidar->identify(DEFAULT_ADDRESS, POWER_UP_TIMEOUT_MICROS) && s.lidar->changeAddress(s.address);
+		} else {
+			s.ready = s.lidar->identify(s.address, POWER_UP_TIMEOUT_MICROS);
+		}
+	}
+	
+	for (size_t i = 0; i < sensors.size(); i++) {
+		Sensor & s = sensors[i];
+		if (!s.ready || (configuration == 0 && s.lidar->getAddress() != DEFAULT_ADDRESS)) continue;
+		s.ready = s.lidar->startConfigure(configuration);
+	}
+	
+	// Poll round robin, backing off while nobody is ready yet
+	int answered = 0;
+	int backoffMicros = 50;
+	vector<size_t> waiting;
+	for (size_t i = 0; i < sensors.size(); i++) {
+		if (sensors[i].ready) waiting.push_back(i);
+	}
+	while (!waiting.empty()) {
+		bool progress = false;
+		size_t n = 0;
+		for (size_t k = 0; k < waiting.size(); k++) {
+			Sensor & s = sensors[waiting[k]];
+			int ready = s.lidar->pollReady();
+			if (ready == 0) {
+				waiting[n++] = waiting[k];
+				continue;
+			}
+			s.ready = (ready == 1);
+			if (s.ready) answered++;
+			progress = true;
+		}
+		waiting.resize(n);
+		if (waiting.empty()) break;
+		if (progress) backoffMicros = 50;
+		usleep(backoffMicros);
+		backoffMicros = min(backoffMicros * 2, 1000);
+	}
+	return answered;
+}
+
+//--------------------------------------------------------------
+int LidarLiteArray::timeToReadyMicros(int sensor) {
+	if (sensor < 0 || sensor >= (int) sensors.size()) return -1;
+	return sensors[sensor].lidar->timeToReadyMicros();
+}
+
+/* =============================================================================
+  measureAll
+  Process
+  ------------------------------------------------------------------------------
+  1.  Trigger every ready sensor back to back
+  2.  Leave each sensor alone until ~80% of its expected acquisition time has
+      passed, then poll its busy flag with a growing back-off (capped at 1ms)
+  3.  Read each sensor's results as soon as its busy flag clears, whichever
+      sensor that is, and sleep until the next sensor is due to be polled
+============================================================================= */
+int LidarLiteArray::measureAll(vector<LidarLiteMeasurement> & results, bool stablizePreampFlag) {
+	typedef chrono::steady_clock Clock;
+	
+	struct Pending {
+		int sensor;
+		Clock::time_point nextPoll;
+		int backoffMicros;
+	};
+	
+	results.resize(sensors.size());
+	order.clear();
+	vector<Pending> pending;
+	pending.reserve(sensors.size());
+	
+	for (size_t i = 0; i < sensors.size(); i++) {
+		results[i].distance = -1;
+		results[i].signalStrength = -1;
+		results[i].maxNoise = -1;
+		results[i].correlationPeakValue = -1;
+		results[i].status = -1;
+		results[i].velocity = 0;
+		if (!sensors[i].ready) continue;
+		
+		LidarLite & lidar = *sensors[i].lidar;
+		if (!lidar.trigger(stablizePreampFlag)) continue;
+		
+		Clock::time_point due = lidar.expectedCompletion();
+		int dueMicros = (int) chrono::duration_cast<chrono::microseconds>(due - Clock::now()).count();
+		Pending p;
+		p.sensor = (int) i;
+		p.nextPoll = due - chrono::microseconds(dueMicros / 5);
+		p.backoffMicros = max(50, dueMicros / 16);
+		pending.push_back(p);
+	}
+	
+	int successes = 0;
+	while (!pending.empty()) {
+		Clock::time_point now = Clock::now();
+		Clock::time_point wake = Clock::time_point::max();
+		
+		for (size_t i = 0; i < pending.size(); ) {
+			Pending & p = pending[i];
+			if (now >= p.nextPoll) {
+				LidarLite & lidar = *sensors[p.sensor].lidar;
+				int done = lidar.pollCompletion();
+				if (done != 0) {
+					if (done == 1 && lidar.readMeasurement(results[p.sensor])) {
+						successes++;
+						order.push_back(p.sensor);
+					}
+					pending[i] = pending.back();
+					pending.pop_back();
+					continue;
+				}
+				now = Clock::now();
+				p.nextPoll = now + chrono::microseconds(p.backoffMicros);
+				p.backoffMicros = min(p.backoffMicros * 2, 1000);
+			}
+			if (p.nextPoll < wake) wake = p.nextPoll;
+			i++;
+		}
+		
+		if (!pending.empty()) std::this_thread::sleep_until(wake);
+	}
+	return successes;
+}
+
+//--------------------------------------------------------------
+const vector<int> & LidarLiteArray::completionOrder() {
+	return order;
+}
+
+//--------------------------------------------------------------
+int LidarLiteArray::sensorCount() {
+	return (int) sensors.size();
+}
+
+//--------------------------------------------------------------
+int LidarLiteArray::busCount() {
+	return (int) buses.size();
+}
+
+//--------------------------------------------------------------
+LidarLite & LidarLiteArray::sensor(int index) {
+	return *sensors[index].lidar;
+}
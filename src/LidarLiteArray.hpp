@@ -0,0 +1,90 @@
+/*
+LidarLiteArray - Drives many LIDAR Lites on one or more I2C buses
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Owns one LidarLiteI2cBus per adapter and one LidarLite per sensor. Every
+LIDAR Lite powers up at 0x62, so sensors sharing a bus need their power enable
+lines wired to the host: begin() powers them up one at a time and moves each
+to its own address, then configures all of them at once and waits for each to
+report ready instead of sleeping a fixed time.
+
+measureAll() triggers every sensor first and then collects the results in
+the order the sensors finish, so the acquisitions overlap and a sweep of N
+sensors takes about one acquisition time plus N result reads, instead of N
+full acquisitions back to back.
+
+Example Usage
+------------------------------------------------------------------------------
+	LidarLiteArray lidars;
+	int bus1 = lidars.addBus(1);
+	// setGpio() being whatever drives the power enable lines on your rig
+	lidars.addSensor(bus1, 0x64, [](bool on) { setGpio(17, on); });
+	lidars.addSensor(bus1, 0x66, [](bool on) { setGpio(27, on); });
+	lidars.begin();
+
+	vector<LidarLiteMeasurement> results;
+	lidars.measureAll(results);
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include <functional>
+#include <vector>
+#include <memory>
+
+class LidarLiteArray
+{
+	public:
+		LidarLiteArray();
+
+		// Opens /dev/i2c-<adapter>, returns the bus index
+		int addBus(int adapter);
+
+		// Adds an existing transport (e.g. a LidarLiteSimulator), returns the bus index
+		int addBus(shared_ptr<LidarLiteI2cBus> bus);
+
+		// Adds a sensor that will answer on address, returns the sensor index.
+		// powerEnable switches the sensor's power enable line; leave it empty if the sensor
+		// already answers on address.
+		int addSensor(int bus, unsigned char address, std::function<void(bool)> powerEnable = std::function<void(bool)>());
+
+		// Assigns addresses and configures every sensor concurrently (see LidarLite::begin).
+		// Returns the number of sensors that answered and became ready.
+		int begin(int configuration = 0);
+		
+		// How long a sensor took from power up (or begin) to ready, -1 if it never was
+		int timeToReadyMicros(int sensor);
+
+		// Triggers every sensor, then reads each as it completes. results is resized to
+		// sensorCount(), failed sensors get distance -1. Returns the number of successful reads.
+		int measureAll(vector<LidarLiteMeasurement> & results, bool stablizePreampFlag = true);
+
+		// Sensor indices in the order they completed during the last measureAll()
+		const vector<int> & completionOrder();
+
+		int sensorCount();
+		int busCount();
+		LidarLite & sensor(int index);
+
+	private:
+		struct Sensor {
+			shared_ptr<LidarLite> lidar;
+			int bus;
+			unsigned char address;
+			std::function<void(bool)> powerEnable;
+			bool ready;
+		};
+
+		vector< shared_ptr<LidarLiteI2cBus> > buses;
+		vector<Sensor> sensors;
+		vector<int> order;
+
+		static const unsigned char DEFAULT_ADDRESS = 0x62;
+		static const int POWER_UP_TIMEOUT_MICROS = 200000;	// Give up on a sensor that doesn't boot in time
+};
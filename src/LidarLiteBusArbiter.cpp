@@ -0,0 +1,353 @@
+/*
+LidarLiteBusArbiter - One thread owning an I2C bus on behalf of many LIDAR Lites
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteBusArbiter.hpp"
+#include <algorithm>
+
+static long long nowNanos() {
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ***************************************************
+// Constructor
+// ***************************************************
+LidarLiteBusArbiter::LidarLiteBusArbiter(shared_ptr<LidarLiteI2cBus> bus, size_t queueCapacity) :
+	bus(bus), requests(queueCapacity) {
+	running = false;
+	sleeping = false;
+}
+// END Constructor
+// ***************************************************
+
+// ***************************************************
+// Destructor
+// ***************************************************
+LidarLiteBusArbiter::~LidarLiteBusArbiter() {
+	stop();
+}
+// END Destructor
+// ***************************************************
+
+// ***************************************************
+// Sensors
+// ***************************************************
+int LidarLiteBusArbiter::addSensor(shared_ptr<LidarLite> lidar, float rateHz, size_t sampleBufferSize) {
+	if (running || !lidar || lidar->getBus() != bus) return -1;
+	shared_ptr<Slot> slot(new Slot(sampleBufferSize));
+	slot->lidar = lidar;
+	slot->periodNanos = (rateHz > 0) ? (long long) (1e9 / rateHz) : 0;
+	slot->requested = false;
+	slot->inFlight = false;
+	slot->backoffMicros = 0;
+	slot->sequence = 0;
+	slot->intervalNanos = 0;
+	slot->lastCompletionNanos = 0;
+	slot->measurements = 0;
+	slot->failures = 0;
+	slot->coalesced = 0;
+	slots.push_back(slot);
+	return (int) slots.size() - 1;
+}
+
+int LidarLiteBusArbiter::sensorCount() {
+	return (int) slots.size();
+}
+
+LidarLite & LidarLiteBusArbiter::sensor(int index) {
+	return *slots[index]->lidar;
+}
+
+shared_ptr<LidarLiteI2cBus> LidarLiteBusArbiter::getBus() {
+	return bus;
+}
+
+void LidarLiteBusArbiter::setResultCallback(ResultCallback callback) {
+	if (running) return;
+	this->callback = callback;
+}
+// END Sensors
+// ***************************************************
+
+// ***************************************************
+// Starts the arbiter thread. Scheduled sensors are
+// first triggered right away.
+// ***************************************************
+void LidarLiteBusArbiter::start() {
+	if (running) return;
+	Clock::time_point now = Clock::now();
+	for (size_t i = 0; i < slots.size(); i++) slots[i]->nextDue = now;
+	running = true;
+	thread = std::thread(&LidarLiteBusArbiter::loop, this);
+}
+
+void LidarLiteBusArbiter::stop() {
+	if (!running) return;
+	running = false;
+	{
+		std::lock_guard<std::mutex> guard(wakeMutex);
+		wake.notify_one();
+	}
+	if (thread.joinable()) thread.join();
+}
+
+bool LidarLiteBusArbiter::isRunning() {
+	return running;
+}
+// END start/stop
+// ***************************************************
+
+// ***************************************************
+// Requests from any thread. After the push, a full fence
+// pairs with the one in sleepUntil(): either the arbiter
+// sees the request before it sleeps, or we see it asleep
+// and wake it.
+// ***************************************************
+bool LidarLiteBusArbiter::request(int sensor) {
+	if (sensor < 0 || sensor >= (int) slots.size()) return false;
+	Request r;
+	r.sensor = sensor;
+	r.rateHz = -1;
+	return submit(r);
+}
+
+bool LidarLiteBusArbiter::setRate(int sensor, float rateHz) {
+	if (sensor < 0 || sensor >= (int) slots.size()) return false;
+	Request r;
+	r.sensor = sensor;
+	r.rateHz = (rateHz > 0) ? rateHz : 0;
+	return submit(r);
+}
+
+bool LidarLiteBusArbiter::submit(const Request & r) {
+	if (!requests.push(r)) return false;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (sleeping.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> guard(wakeMutex);
+		wake.notify_one();
+	}
+	return true;
+}
+
+unsigned long LidarLiteBusArbiter::droppedRequests() {
+	return requests.dropCount();
+}
+// END Requests
+// ***************************************************
+
+/* =============================================================================
+  loop
+  Process
+  ------------------------------------------------------------------------------
+  1.  Take every queued request, folding repeats for the same sensor together
+  2.  Mark the sensors whose scheduled time has come
+  3.  Trigger every marked sensor that isn't already measuring
+  4.  Poll the sensors in flight that are nearly due and read each one that
+      has finished, whichever that is
+  5.  Sleep until the next poll or scheduled trigger, or until a request
+      arrives
+  Once stopped, the sensors in flight are still read so none is left busy.
+============================================================================= */
+void LidarLiteBusArbiter::loop() {
+	while (running) {
+		Clock::time_point now = Clock::now();
+		takeRequests(now);
+		schedule(now);
+		triggerRequested();
+		pollInFlight();
+
+		Clock::time_point wakeTime = Clock::time_point::max();
+		for (size_t i = 0; i < slots.size(); i++) {
+			Slot & slot = *slots[i];
+			if (slot.inFlight) wakeTime = std::min(wakeTime, slot.nextPoll);
+			if (slot.periodNanos > 0) wakeTime = std::min(wakeTime, slot.nextDue);
+		}
+		sleepUntil(wakeTime);
+	}
+
+	while (true) {
+		pollInFlight();
+		Clock::time_point wakeTime = Clock::time_point::max();
+		for (size_t i = 0; i < slots.size(); i++) {
+			if (slots[i]->inFlight) wakeTime = std::min(wakeTime, slots[i]->nextPoll);
+		}
+		if (wakeTime == Clock::time_point::max()) break;
+		std::this_thread::sleep_until(wakeTime);
+	}
+	for (size_t i = 0; i < slots.size(); i++) slots[i]->requested = false;
+}
+
+//--------------------------------------------------------------
+void LidarLiteBusArbiter::takeRequests(Clock::time_point now) {
+	Request r;
+	while (requests.pop(r)) {
+		Slot & slot = *slots[r.sensor];
+		if (r.rateHz >= 0) {
+			slot.periodNanos = (r.rateHz > 0) ? (long long) (1e9 / r.rateHz) : 0;
+			slot.nextDue = now;
+		} else if (slot.requested || slot.inFlight) {
+			slot.coalesced.fetch_add(1, std::memory_order_relaxed);
+		} else {
+			slot.requested = true;
+		}
+	}
+}
+
+//--------------------------------------------------------------
+// Advances each due sensor by one period. A sensor more than a
+// period behind restarts from now instead of bursting to catch up.
+void LidarLiteBusArbiter::schedule(Clock::time_point now) {
+	for (size_t i = 0; i < slots.size(); i++) {
+		Slot & slot = *slots[i];
+		if (slot.periodNanos == 0 || now < slot.nextDue) continue;
+		if (slot.requested || slot.inFlight) slot.coalesced.fetch_add(1, std::memory_order_relaxed);
+		else slot.requested = true;
+		chrono::nanoseconds period(slot.periodNanos);
+		slot.nextDue += period;
+		if (slot.nextDue <= now - period) slot.nextDue = now + period;
+	}
+}
+
+//--------------------------------------------------------------
+// Polling starts at ~80% of the expected acquisition time, with a
+// back-off growing from 1/16 of it, as in LidarLiteArray::measureAll()
+void LidarLiteBusArbiter::triggerRequested() {
+	for (size_t i = 0; i < slots.size(); i++) {
+		Slot & slot = *slots[i];
+		if (!slot.requested || slot.inFlight) continue;
+		slot.requested = false;
+		LidarLite & lidar = *slot.lidar;
+		if (!lidar.trigger()) {
+			finish((int) i, false, LidarLiteMeasurement());
+			continue;
+		}
+		Clock::time_point due = lidar.expectedCompletion();
+		int dueMicros = (int) chrono::duration_cast<chrono::microseconds>(due - Clock::now()).count();
+		slot.inFlight = true;
+		slot.nextPoll = due - chrono::microseconds(dueMicros / 5);
+		slot.backoffMicros = std::max(50, dueMicros / 16);
+	}
+}
+
+//--------------------------------------------------------------
+void LidarLiteBusArbiter::pollInFlight() {
+	Clock::time_point now = Clock::now();
+	for (size_t i = 0; i < slots.size(); i++) {
+		Slot & slot = *slots[i];
+		if (!slot.inFlight || now < slot.nextPoll) continue;
+		LidarLite & lidar = *slot.lidar;
+		int done = lidar.pollCompletion();
+		if (done != 0) {
+			LidarLiteMeasurement m = LidarLiteMeasurement();
+			bool success = (done == 1) && lidar.readMeasurement(m);
+			slot.inFlight = false;
+			finish((int) i, success, m);
+		} else {
+			slot.nextPoll = Clock::now() + chrono::microseconds(slot.backoffMicros);
+			slot.backoffMicros = std::min(slot.backoffMicros * 2, 1000);
+		}
+		now = Clock::now();
+	}
+}
+
+/* =============================================================================
+  finish
+  Publishes one sensor's result and updates its counters. The achieved rate
+  is an exponential moving average of the time between successful
+  measurements, weighted 1/RATE_SMOOTHING towards the newest.
+============================================================================= */
+void LidarLiteBusArbiter::finish(int sensor, bool success, const LidarLiteMeasurement & m) {
+	Slot & slot = *slots[sensor];
+	LidarLiteMeasurement result = m;
+	if (!success) {
+		result.distance = -1;
+		result.signalStrength = -1;
+		result.maxNoise = -1;
+		result.correlationPeakValue = -1;
+		result.status = -1;
+		result.velocity = 0;
+		slot.failures.fetch_add(1, std::memory_order_relaxed);
+	} else {
+		LidarLiteSample sample;
+		sample.distance = m.distance;
+		sample.rawDistance = m.distance;
+		sample.signalStrength = m.signalStrength;
+		sample.status = m.status;
+		sample.velocity = m.velocity;
+		sample.timestampNanos = (unsigned long long) nowNanos();
+		sample.sequence = slot.sequence++;
+		slot.samples.push(sample);
+
+		long long last = slot.lastCompletionNanos.load(std::memory_order_relaxed);
+		if (last != 0) {
+			long long interval = (long long) sample.timestampNanos - last;
+			long long average = slot.intervalNanos.load(std::memory_order_relaxed);
+			average = (average == 0) ? interval : average + (interval - average) / RATE_SMOOTHING;
+			slot.intervalNanos.store(average, std::memory_order_relaxed);
+		}
+		slot.lastCompletionNanos.store((long long) sample.timestampNanos, std::memory_order_relaxed);
+		slot.measurements.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (callback) callback(sensor, success, result);
+}
+
+//--------------------------------------------------------------
+void LidarLiteBusArbiter::sleepUntil(Clock::time_point wakeTime) {
+	std::unique_lock<std::mutex> guard(wakeMutex);
+	sleeping.store(true, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (running && requests.empty()) {
+		if (wakeTime == Clock::time_point::max()) wake.wait(guard);
+		else wake.wait_until(guard, wakeTime);
+	}
+	sleeping.store(false, std::memory_order_relaxed);
+}
+// END loop
+// ***************************************************
+
+// ***************************************************
+// Results
+// ***************************************************
+size_t LidarLiteBusArbiter::drain(int sensor, LidarLiteSample * samples, size_t maxSamples) {
+	return slots[sensor]->samples.drain(samples, maxSamples);
+}
+
+size_t LidarLiteBusArbiter::drain(int sensor, vector<LidarLiteSample> & samples) {
+	return slots[sensor]->samples.drain(samples);
+}
+
+unsigned long LidarLiteBusArbiter::overrunCount(int sensor) {
+	return slots[sensor]->samples.overrunCount();
+}
+
+// Reported from the smoothed interval, or from the time since the last
+// measurement once that is longer, so a stalled sensor's rate falls off
+float LidarLiteBusArbiter::achievedRate(int sensor) {
+	Slot & slot = *slots[sensor];
+	long long interval = slot.intervalNanos.load(std::memory_order_relaxed);
+	long long last = slot.lastCompletionNanos.load(std::memory_order_relaxed);
+	if (interval <= 0) return 0;
+	long long since = nowNanos() - last;
+	if (since > interval) interval = since;
+	return (float) (1e9 / interval);
+}
+
+unsigned long LidarLiteBusArbiter::measurementCount(int sensor) {
+	return slots[sensor]->measurements.load(std::memory_order_relaxed);
+}
+
+unsigned long LidarLiteBusArbiter::failureCount(int sensor) {
+	return slots[sensor]->failures.load(std::memory_order_relaxed);
+}
+
+unsigned long LidarLiteBusArbiter::coalescedCount(int sensor) {
+	return slots[sensor]->coalesced.load(std::memory_order_relaxed);
+}
+// END Results
+// ***************************************************
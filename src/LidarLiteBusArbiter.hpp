@@ -0,0 +1,160 @@
+/*
+LidarLiteBusArbiter - One thread owning an I2C bus on behalf of many LIDAR Lites
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+A LidarLiteReader per sensor means a thread per sensor, all contending for the
+same adapter and waking each other up. The arbiter runs every transaction on
+one adapter from a single thread instead. Any thread asks for a measurement
+with request(), which is a push onto a lock-free queue, or gives a sensor a
+rate and lets the arbiter schedule it. The arbiter then:
+	- coalesces requests for a sensor that is already waiting or measuring
+	- triggers every requested sensor before reading anything back, so the
+	  acquisitions overlap
+	- polls each sensor only once it is nearly due (see LidarLiteArray) and
+	  reads the results in the order the sensors finish
+	- sleeps until the next poll or scheduled trigger, or a new request
+so the CPU it uses grows with the measurement rate, not the sensor count.
+
+Results go to a lock-free ring per sensor, drained like LidarLiteReader, and
+optionally to a callback on the arbiter thread. achievedRate() reports the
+rate each sensor is actually measured at.
+
+The sensors must be constructed on the arbiter's bus and, once start() is
+called, only be used through the arbiter.
+
+Example Usage
+------------------------------------------------------------------------------
+	shared_ptr<LidarLiteI2cBus> bus(new LidarLiteLinuxI2cBus(1));
+	LidarLiteBusArbiter arbiter(bus);
+	// Sensors already moved to their own addresses, e.g. by LidarLiteArray
+	shared_ptr<LidarLite> a(new LidarLite(bus)), b(new LidarLite(bus));
+	a->begin(0, false, false, 0x64);
+	b->begin(0, false, false, 0x66);
+	int left = arbiter.addSensor(a, 100);
+	int right = arbiter.addSensor(b, 100);
+	arbiter.start();
+	vector<LidarLiteSample> samples;
+	while (true) {
+		usleep(100000);
+		arbiter.drain(left, samples);
+		cout << arbiter.achievedRate(left) << " Hz" << endl;
+		...
+	}
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include "LidarLiteRing.hpp"
+#include "LidarLiteQueue.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <memory>
+
+class LidarLiteBusArbiter
+{
+	public:
+		// queueCapacity bounds the requests waiting to be picked up, see droppedRequests()
+		LidarLiteBusArbiter(shared_ptr<LidarLiteI2cBus> bus, size_t queueCapacity = 256);
+		~LidarLiteBusArbiter();
+
+		// Adds a sensor measured every 1/rateHz seconds, or only on request() when rateHz is 0.
+		// Returns the sensor index, or -1 if lidar is on another bus or the arbiter is running.
+		int addSensor(shared_ptr<LidarLite> lidar, float rateHz = 0, size_t sampleBufferSize = 1024);
+
+		void start();							// Start the arbiter thread
+		void stop();							// Stop it once the measurements in flight are read
+		bool isRunning();
+
+		// Any thread. Asks for one measurement of sensor; a request for a sensor that already has one
+		// waiting or in flight is coalesced into it. The request is a lock-free push, only waking a
+		// sleeping arbiter takes its mutex. Returns false if sensor is unknown or the queue was full.
+		bool request(int sensor);
+
+		// Any thread, like request(). Changes the sensor's scheduled rate, 0 to measure on request only.
+		bool setRate(int sensor, float rateHz);
+
+		// Results, delivered on the arbiter thread as each sensor is read. success is false if the
+		// trigger, busy wait or read failed; measurement.distance is -1 then.
+		typedef std::function<void(int sensor, bool success, const LidarLiteMeasurement & measurement)> ResultCallback;
+		void setResultCallback(ResultCallback callback);	// Call before start()
+
+		// Lock-free access to each sensor's samples, one consumer thread per sensor
+		size_t drain(int sensor, LidarLiteSample * samples, size_t maxSamples);
+		size_t drain(int sensor, vector<LidarLiteSample> & samples);
+		unsigned long overrunCount(int sensor);			// Samples dropped because drain() wasn't called often enough
+
+		// Per sensor counters, safe to read from any thread
+		float achievedRate(int sensor);					// Measurements per second over the last few, falls while none arrive
+		unsigned long measurementCount(int sensor);		// Successful measurements
+		unsigned long failureCount(int sensor);			// Failed triggers, busy timeouts and reads
+		unsigned long coalescedCount(int sensor);		// Requests and scheduled triggers merged into one already pending
+		unsigned long droppedRequests();				// request()/setRate() calls lost to a full queue
+
+		int sensorCount();
+		LidarLite & sensor(int index);
+		shared_ptr<LidarLiteI2cBus> getBus();
+
+	private:
+		typedef chrono::steady_clock Clock;
+
+		struct Request {
+			int sensor;
+			float rateHz;						// New rate, or < 0 for a measurement request
+		};
+
+		struct Slot {
+			shared_ptr<LidarLite> lidar;
+			LidarLiteRing<LidarLiteSample> samples;
+			// Arbiter thread only
+			long long periodNanos;				// 0 if measured on request only
+			Clock::time_point nextDue;			// Next scheduled trigger
+			bool requested;						// Waiting to be triggered
+			bool inFlight;						// Triggered, not yet read
+			Clock::time_point nextPoll;			// When to next check the busy flag
+			int backoffMicros;					// Poll interval, doubles up to 1ms
+			unsigned int sequence;				// Of the next sample
+			// Written by the arbiter thread, read anywhere
+			std::atomic<long long> intervalNanos;		// Smoothed time between measurements, 0 until there are two
+			std::atomic<long long> lastCompletionNanos;	// steady_clock time of the last measurement, 0 if none
+			std::atomic<unsigned long> measurements;
+			std::atomic<unsigned long> failures;
+			std::atomic<unsigned long> coalesced;
+
+			Slot(size_t sampleBufferSize) : samples(sampleBufferSize) {}
+		};
+
+		shared_ptr<LidarLiteI2cBus> bus;
+		vector< shared_ptr<Slot> > slots;
+		LidarLiteQueue<Request> requests;
+		ResultCallback callback;
+		std::thread thread;
+		std::atomic<bool> running;
+		std::atomic<bool> sleeping;				// Whether producers need to wake the arbiter
+		std::mutex wakeMutex;
+		std::condition_variable wake;
+
+		void loop();
+		void takeRequests(Clock::time_point now);
+		void schedule(Clock::time_point now);
+		void triggerRequested();
+		void pollInFlight();
+		void finish(int sensor, bool success, const LidarLiteMeasurement & m);
+		void sleepUntil(Clock::time_point wakeTime);
+		bool submit(const Request & r);
+
+		static const int RATE_SMOOTHING = 8;	// Achieved rate is an EMA over about this many intervals
+
+		// Not copyable, owns a thread
+		LidarLiteBusArbiter(const LidarLiteBusArbiter &);
+		LidarLiteBusArbiter & operator=(const LidarLiteBusArbiter &);
+};
@@ -0,0 +1,152 @@
+/*
+LidarLiteCorrelation - Raw correlation records and a vectorized peak/noise analysis
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteCorrelation.hpp"
+#include <cstddef>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIDARLITE_CORRELATION_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LIDARLITE_CORRELATION_NEON
+#endif
+
+// 32 bit lane sums of 16 bit absolute values can't overflow within a chunk this size
+static const int ABS_SUM_CHUNK = 8192;
+
+//--------------------------------------------------------------
+const char * LidarLiteCorrelation::kernelName() {
+#if defined(LIDARLITE_CORRELATION_SSE2)
+	return "sse2";
+#elif defined(LIDARLITE_CORRELATION_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+/* =============================================================================
+  maxValue
+  Eight entries per step with unaligned loads, so any sub-range of a record
+  can be passed, then a scalar tail.
+============================================================================= */
+int LidarLiteCorrelation::maxValue(const int16_t * values, int count) {
+	int i = 0;
+	int best = INT16_MIN;
+#if defined(LIDARLITE_CORRELATION_SSE2)
+	if (count >= 8) {
+		__m128i m = _mm_loadu_si128((const __m128i *) values);
+		for (i = 8; i + 8 <= count; i += 8) m = _mm_max_epi16(m, _mm_loadu_si128((const __m128i *) (values + i)));
+		m = _mm_max_epi16(m, _mm_srli_si128(m, 8));
+		m = _mm_max_epi16(m, _mm_srli_si128(m, 4));
+		m = _mm_max_epi16(m, _mm_srli_si128(m, 2));
+		best = (int16_t) _mm_cvtsi128_si32(m);
+	}
+#elif defined(LIDARLITE_CORRELATION_NEON)
+	if (count >= 8) {
+		int16x8_t m = vld1q_s16(values);
+		for (i = 8; i + 8 <= count; i += 8) m = vmaxq_s16(m, vld1q_s16(values + i));
+#if defined(__aarch64__)
+		best = vmaxvq_s16(m);
+#else
+		int16x4_t h = vpmax_s16(vget_low_s16(m), vget_high_s16(m));
+		h = vpmax_s16(h, h);
+		h = vpmax_s16(h, h);
+		best = vget_lane_s16(h, 0);
+#endif
+	}
+#endif
+	for (; i < count; i++) if (values[i] > best) best = values[i];
+	return best;
+}
+
+/* =============================================================================
+  absSum
+  Sum of absolute values. The vector versions saturate |-32768| to 32767,
+  which the sensor's 9 bit correlation values never reach.
+============================================================================= */
+long long LidarLiteCorrelation::absSum(const int16_t * values, int count) {
+	long long total = 0;
+	int i = 0;
+#if defined(LIDARLITE_CORRELATION_SSE2)
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	while (i + 8 <= count) {
+		int end = (count - i > ABS_SUM_CHUNK) ? i + ABS_SUM_CHUNK : count;
+		__m128i acc = _mm_setzero_si128();
+		for (; i + 8 <= end; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i *) (values + i));
+			__m128i a = _mm_max_epi16(v, _mm_subs_epi16(zero, v));
+			acc = _mm_add_epi32(acc, _mm_madd_epi16(a, ones));
+		}
+		acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 8));
+		acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+		total += _mm_cvtsi128_si32(acc);
+	}
+#elif defined(LIDARLITE_CORRELATION_NEON)
+	while (i + 8 <= count) {
+		int end = (count - i > ABS_SUM_CHUNK) ? i + ABS_SUM_CHUNK : count;
+		int32x4_t acc = vdupq_n_s32(0);
+		for (; i + 8 <= end; i += 8) acc = vpadalq_s16(acc, vqabsq_s16(vld1q_s16(values + i)));
+#if defined(__aarch64__)
+		total += vaddvq_s32(acc);
+#else
+		total += vgetq_lane_s32(acc, 0) + vgetq_lane_s32(acc, 1) + vgetq_lane_s32(acc, 2) + vgetq_lane_s32(acc, 3);
+#endif
+	}
+#endif
+	for (; i < count; i++) total += (values[i] < 0) ? -values[i] : values[i];
+	return total;
+}
+
+/* =============================================================================
+  analyze
+  1.  Vector max over the record, then the first bin holding it.
+  2.  Walk out from the peak while the record keeps falling to find the main
+      lobe, so a wide peak isn't reported as its own second peak.
+  3.  Vector max and absolute sum over what is left on either side.
+============================================================================= */
+LidarLiteCorrelationPeaks LidarLiteCorrelation::analyze(const int16_t * values, int count) {
+	LidarLiteCorrelationPeaks peaks;
+	peaks.peakIndex = -1;
+	peaks.peakValue = 0;
+	peaks.secondPeakIndex = -1;
+	peaks.secondPeakValue = 0;
+	peaks.noiseFloor = 0;
+	if (values == NULL || count <= 0) return peaks;
+
+	peaks.peakValue = maxValue(values, count);
+	int peak = 0;
+	while (values[peak] != peaks.peakValue) peak++;
+	peaks.peakIndex = peak;
+
+	// Main lobe is [lo, hi)
+	int lo = peak;
+	while (lo > 0 && values[lo - 1] <= values[lo]) lo--;
+	int hi = peak + 1;
+	while (hi < count && values[hi] <= values[hi - 1]) hi++;
+
+	int left = maxValue(values, lo);
+	int right = maxValue(values + hi, count - hi);
+	if (lo > 0 || hi < count) {
+		peaks.secondPeakValue = (left >= right) ? left : right;
+		int second = (left >= right) ? 0 : hi;
+		while (values[second] != peaks.secondPeakValue) second++;
+		peaks.secondPeakIndex = second;
+	}
+
+	int outside = count - (hi - lo);
+	if (outside > 0) {
+		long long sum = absSum(values, lo) + absSum(values + hi, count - hi);
+		peaks.noiseFloor = (int) ((sum + outside / 2) / outside);
+	}
+	return peaks;
+}
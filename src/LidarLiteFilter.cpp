@@ -0,0 +1,164 @@
+/*
+LidarLiteFilter - Streaming filters for LIDAR Lite samples
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteFilter.hpp"
+
+// ***************************************************
+// LidarLiteFilterPipeline
+// ***************************************************
+LidarLiteFilterPipeline::LidarLiteFilterPipeline() {
+}
+
+void LidarLiteFilterPipeline::add(shared_ptr<LidarLiteFilter> filter) {
+	if (filter) stages.push_back(filter);
+}
+
+bool LidarLiteFilterPipeline::process(LidarLiteSample & sample) {
+	for (size_t i = 0; i < stages.size(); i++) {
+		if (!stages[i]->process(sample)) {
+			sample.distance = -1;
+			return false;
+		}
+	}
+	return true;
+}
+
+void LidarLiteFilterPipeline::reset() {
+	for (size_t i = 0; i < stages.size(); i++) stages[i]->reset();
+}
+// END LidarLiteFilterPipeline
+// ***************************************************
+
+// ***************************************************
+// LidarLiteOutlierFilter
+// ***************************************************
+LidarLiteOutlierFilter::LidarLiteOutlierFilter(int rejectStatusMask, int minSignalStrength) {
+	this->rejectStatusMask = rejectStatusMask;
+	this->minSignalStrength = minSignalStrength;
+}
+
+bool LidarLiteOutlierFilter::process(LidarLiteSample & sample) {
+	if (sample.distance < 0) return false;
+	// status is -1 when it wasn't read, nothing to judge then
+	if (sample.status != -1 && (sample.status & rejectStatusMask) != 0) return false;
+	return sample.signalStrength >= minSignalStrength;
+}
+// END LidarLiteOutlierFilter
+// ***************************************************
+
+// ***************************************************
+// LidarLiteMedianFilter
+// Keeps the window in arrival order and insertion sorts a copy,
+// at most MAX_WINDOW^2 / 2 compares per sample.
+// ***************************************************
+LidarLiteMedianFilter::LidarLiteMedianFilter(int windowSize) {
+	if (windowSize < 1) windowSize = 1;
+	if (windowSize > MAX_WINDOW) windowSize = MAX_WINDOW;
+	this->windowSize = windowSize;
+	reset();
+}
+
+bool LidarLiteMedianFilter::process(LidarLiteSample & sample) {
+	if (sample.distance < 0) return false;
+
+	history[next] = sample.distance;
+	next = (next + 1) % windowSize;
+	if (count < windowSize) count++;
+
+	for (int i = 0; i < count; i++) {
+		int value = history[i];
+		int j = i;
+		while (j > 0 && sorted[j - 1] > value) {
+			sorted[j] = sorted[j - 1];
+			j--;
+		}
+		sorted[j] = value;
+	}
+	sample.distance = sorted[count / 2];
+	return true;
+}
+
+void LidarLiteMedianFilter::reset() {
+	count = 0;
+	next = 0;
+}
+// END LidarLiteMedianFilter
+// ***************************************************
+
+// ***************************************************
+// LidarLiteSignalWeightedFilter
+// ***************************************************
+LidarLiteSignalWeightedFilter::LidarLiteSignalWeightedFilter(int minSignalStrength, int fullSignalStrength, float minWeight) {
+	this->minSignalStrength = minSignalStrength;
+	this->fullSignalStrength = (fullSignalStrength > minSignalStrength) ? fullSignalStrength : minSignalStrength + 1;
+	this->minWeight = minWeight;
+	reset();
+}
+
+bool LidarLiteSignalWeightedFilter::process(LidarLiteSample & sample) {
+	// Too weak, most likely sunlight or nothing in range
+	if (sample.distance < 0 || sample.signalStrength < minSignalStrength) return false;
+
+	float weight = 1.f;
+	if (sample.signalStrength < fullSignalStrength) {
+		weight = minWeight + (1.f - minWeight) * (sample.signalStrength - minSignalStrength)
+			/ (float) (fullSignalStrength - minSignalStrength);
+	}
+	average = primed ? sample.distance * weight + average * (1.f - weight) : sample.distance;
+	primed = true;
+	sample.distance = (int) (average + 0.5f);
+	return true;
+}
+
+void LidarLiteSignalWeightedFilter::reset() {
+	average = 0;
+	primed = false;
+}
+// END LidarLiteSignalWeightedFilter
+// ***************************************************
+
+// ***************************************************
+// LidarLiteKalmanFilter
+// ***************************************************
+LidarLiteKalmanFilter::LidarLiteKalmanFilter(float processNoise, float measurementNoise) {
+	this->processNoise = processNoise;
+	this->measurementNoise = measurementNoise;
+	reset();
+}
+
+bool LidarLiteKalmanFilter::process(LidarLiteSample & sample) {
+	if (sample.distance < 0) return false;
+
+	if (!primed) {
+		estimate = sample.distance;
+		variance = measurementNoise;
+		primed = true;
+	} else {
+		// Predict: the distance may have wandered since the last sample
+		float dt = (sample.timestampNanos - lastTimestampNanos) * 1e-9f;
+		variance += processNoise * dt;
+		// Update
+		float gain = variance / (variance + measurementNoise);
+		estimate += gain * (sample.distance - estimate);
+		variance *= (1.f - gain);
+	}
+	lastTimestampNanos = sample.timestampNanos;
+	sample.distance = (int) (estimate + 0.5f);
+	return true;
+}
+
+void LidarLiteKalmanFilter::reset() {
+	estimate = 0;
+	variance = 0;
+	lastTimestampNanos = 0;
+	primed = false;
+}
+// END LidarLiteKalmanFilter
+// ***************************************************
@@ -0,0 +1,133 @@
+/*
+LidarLiteFilter - Streaming filters for LIDAR Lite samples
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Each filter takes one sample at a time and rewrites its distance in place.
+State is sized in the constructor, so process() never allocates and costs the
+same for every sample. Filters are chained with LidarLiteFilterPipeline and
+run on the acquisition thread by LidarLiteReader::setFilter().
+
+process() returns false when the sample holds no usable distance (e.g. no
+signal). The pipeline then stops, sets the distance to -1 and leaves the
+state of later stages untouched.
+
+Example Usage
+------------------------------------------------------------------------------
+	shared_ptr<LidarLiteFilterPipeline> filter(new LidarLiteFilterPipeline());
+	filter->add(shared_ptr<LidarLiteFilter>(new LidarLiteOutlierFilter()));
+	filter->add(shared_ptr<LidarLiteFilter>(new LidarLiteMedianFilter(5)));
+	filter->add(shared_ptr<LidarLiteFilter>(new LidarLiteSignalWeightedFilter(20, 80)));
+	myLidarLite.setFilter(filter);
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include <vector>
+#include <memory>
+
+class LidarLiteFilter
+{
+	public:
+		virtual ~LidarLiteFilter() {}
+
+		// Filters sample.distance in place, returns false to reject the sample
+		virtual bool process(LidarLiteSample & sample) = 0;
+
+		// Forgets all history
+		virtual void reset() {}
+};
+
+// Runs filters in order, stopping at the first one that rejects the sample
+class LidarLiteFilterPipeline : public LidarLiteFilter
+{
+	public:
+		LidarLiteFilterPipeline();
+
+		// Appends a stage. Not thread safe, build the pipeline before it is used.
+		void add(shared_ptr<LidarLiteFilter> filter);
+
+		bool process(LidarLiteSample & sample);
+		void reset();
+
+	private:
+		vector< shared_ptr<LidarLiteFilter> > stages;
+};
+
+// Rejects samples whose status has any of rejectStatusMask set, or whose
+// signal strength is below minSignalStrength
+class LidarLiteOutlierFilter : public LidarLiteFilter
+{
+	public:
+		LidarLiteOutlierFilter(int rejectStatusMask = LidarLite::STATUS_SIGNAL_INVALID | LidarLite::STATUS_SECOND_PEAK,
+			int minSignalStrength = 0);
+
+		bool process(LidarLiteSample & sample);
+
+	private:
+		int rejectStatusMask;
+		int minSignalStrength;
+};
+
+// Median of the last windowSize distances, removes isolated spikes
+class LidarLiteMedianFilter : public LidarLiteFilter
+{
+	public:
+		static const int MAX_WINDOW = 31;
+
+		LidarLiteMedianFilter(int windowSize = 5);	// Clamped to 1..MAX_WINDOW
+
+		bool process(LidarLiteSample & sample);
+		void reset();
+
+	private:
+		int windowSize;
+		int count;								// Distances in history, up to windowSize
+		int next;								// Where the next distance goes in history
+		int history[MAX_WINDOW];
+		int sorted[MAX_WINDOW];
+};
+
+// Exponential average weighted by signal strength: a sample at fullSignalStrength
+// replaces the average, weaker samples move it proportionally less, down to
+// minWeight at minSignalStrength. Samples below minSignalStrength are rejected.
+class LidarLiteSignalWeightedFilter : public LidarLiteFilter
+{
+	public:
+		LidarLiteSignalWeightedFilter(int minSignalStrength = 20, int fullSignalStrength = 80, float minWeight = 0.05f);
+
+		bool process(LidarLiteSample & sample);
+		void reset();
+
+	private:
+		int minSignalStrength;
+		int fullSignalStrength;
+		float minWeight;
+		float average;
+		bool primed;							// Whether average holds a distance yet
+};
+
+// One-dimensional Kalman filter with a random-walk distance model.
+// processNoise is the variance (cm^2) the distance gains per second,
+// measurementNoise the variance of one reading.
+class LidarLiteKalmanFilter : public LidarLiteFilter
+{
+	public:
+		LidarLiteKalmanFilter(float processNoise = 400.f, float measurementNoise = 4.f);
+
+		bool process(LidarLiteSample & sample);
+		void reset();
+
+	private:
+		float processNoise;
+		float measurementNoise;
+		float estimate;
+		float variance;
+		unsigned long long lastTimestampNanos;
+		bool primed;							// Whether estimate holds a distance yet
+};
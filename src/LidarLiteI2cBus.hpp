@@ -0,0 +1,38 @@
+/*
+LidarLiteI2cBus - I2C transport interface used by LidarLite
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+LidarLite never talks to the I2C hardware directly. Every register access
+goes through a LidarLiteI2cBus, which lets the same driver code run against
+the Linux /dev/i2c-N adapter (LidarLiteLinuxI2cBus) or against an in-process
+simulated sensor (LidarLiteSimulator) on machines without a LIDAR Lite.
+
+A single bus object represents one I2C adapter and may be shared by any
+number of LidarLite objects at different device addresses.
+*/
+
+#pragma once
+
+class LidarLiteI2cBus
+{
+	public:
+		virtual ~LidarLiteI2cBus() {}
+
+		// Returns whether the adapter was opened successfully
+		virtual bool isOpen() = 0;
+
+		// Read one register of the device at address. Returns 0-255, or -1 on error
+		virtual int readReg8(unsigned char address, unsigned char reg) = 0;
+
+		// Write one register of the device at address. Returns 0 on success, or -1 on error
+		virtual int writeReg8(unsigned char address, unsigned char reg, unsigned char value) = 0;
+
+		// Read length bytes starting at reg in a single transaction. Returns 0 on success, or -1 on error.
+		// Set the high bit of reg (e.g. 0x8f) to have the LIDAR Lite auto-increment the register address.
+		virtual int readBlock(unsigned char address, unsigned char reg, unsigned char * buffer, int length) = 0;
+};
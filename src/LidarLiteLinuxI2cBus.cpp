@@ -0,0 +1,119 @@
+/*
+LidarLiteLinuxI2cBus - LidarLiteI2cBus backed by a Linux /dev/i2c-N adapter
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteLinuxI2cBus.hpp"
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+//--------------------------------------------------------------
+LidarLiteLinuxI2cBus::LidarLiteLinuxI2cBus(int adapter) {
+	fd = -1;
+	std::stringstream path;
+	path << "/dev/i2c-" << adapter;
+	open(path.str());
+}
+
+//--------------------------------------------------------------
+LidarLiteLinuxI2cBus::LidarLiteLinuxI2cBus(const std::string & devicePath) {
+	fd = -1;
+	open(devicePath);
+}
+
+//--------------------------------------------------------------
+LidarLiteLinuxI2cBus::~LidarLiteLinuxI2cBus() {
+	if (fd > -1) ::close(fd);
+}
+
+//--------------------------------------------------------------
+void LidarLiteLinuxI2cBus::open(const std::string & devicePath) {
+	fd = ::open(devicePath.c_str(), O_RDWR);
+}
+
+//--------------------------------------------------------------
+bool LidarLiteLinuxI2cBus::isOpen() {
+	return (fd > -1);
+}
+
+/* =============================================================================
+  readReg8
+  Reads one register as a single combined transaction: a one byte write of the
+  register address followed by a repeated start and a one byte read. This is
+  the same bus traffic as the SMBus "read byte data" command used by WiringPi.
+============================================================================= */
+int LidarLiteLinuxI2cBus::readReg8(unsigned char address, unsigned char reg) {
+	if (fd < 0) return -1;
+
+	unsigned char value = 0;
+	struct i2c_msg msgs[2];
+	msgs[0].addr = address;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &reg;
+	msgs[1].addr = address;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = 1;
+	msgs[1].buf = &value;
+
+	struct i2c_rdwr_ioctl_data data;
+	data.msgs = msgs;
+	data.nmsgs = 2;
+
+	if (ioctl(fd, I2C_RDWR, &data) < 0) return -1;
+	return (int) value;
+}
+
+//--------------------------------------------------------------
+int LidarLiteLinuxI2cBus::writeReg8(unsigned char address, unsigned char reg, unsigned char value) {
+	if (fd < 0) return -1;
+
+	unsigned char buf[2] = { reg, value };
+	struct i2c_msg msg;
+	msg.addr = address;
+	msg.flags = 0;
+	msg.len = 2;
+	msg.buf = buf;
+
+	struct i2c_rdwr_ioctl_data data;
+	data.msgs = &msg;
+	data.nmsgs = 1;
+
+	if (ioctl(fd, I2C_RDWR, &data) < 0) return -1;
+	return 0;
+}
+
+/* =============================================================================
+  readBlock
+  Same combined write/read as readReg8 with a longer read phase, so a whole
+  run of result registers costs one I2C_RDWR ioctl and one bus transaction.
+============================================================================= */
+int LidarLiteLinuxI2cBus::readBlock(unsigned char address, unsigned char reg, unsigned char * buffer, int length) {
+	if (fd < 0 || length <= 0) return -1;
+
+	struct i2c_msg msgs[2];
+	msgs[0].addr = address;
+	msgs[0].flags = 0;
+	msgs[0].len = 1;
+	msgs[0].buf = &reg;
+	msgs[1].addr = address;
+	msgs[1].flags = I2C_M_RD;
+	msgs[1].len = (unsigned short) length;
+	msgs[1].buf = buffer;
+
+	struct i2c_rdwr_ioctl_data data;
+	data.msgs = msgs;
+	data.nmsgs = 2;
+
+	if (ioctl(fd, I2C_RDWR, &data) < 0) return -1;
+	return 0;
+}
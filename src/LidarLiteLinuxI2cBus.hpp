@@ -0,0 +1,48 @@
+/*
+LidarLiteLinuxI2cBus - LidarLiteI2cBus backed by a Linux /dev/i2c-N adapter
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Talks to the i2c-dev kernel driver with I2C_RDWR ioctls. The device address
+travels with every message, so one open adapter serves every sensor on it
+without re-issuing I2C_SLAVE between sensors.
+
+Requirements:
+	Turn on I2C by calling sudo raspi-config
+	printf 'i2c_bcm2708\ni2c-dev\n' | sudo tee --append /etc/modules
+*/
+
+#pragma once
+
+#include "LidarLiteI2cBus.hpp"
+#include <string>
+
+class LidarLiteLinuxI2cBus : public LidarLiteI2cBus
+{
+	public:
+		// Opens /dev/i2c-<adapter>. Raspberry Pi rev 2 and later expose the GPIO header on adapter 1.
+		LidarLiteLinuxI2cBus(int adapter = 1);
+
+		// Opens the given i2c-dev device node
+		LidarLiteLinuxI2cBus(const std::string & devicePath);
+
+		~LidarLiteLinuxI2cBus();
+
+		bool isOpen();
+		int readReg8(unsigned char address, unsigned char reg);
+		int writeReg8(unsigned char address, unsigned char reg, unsigned char value);
+		int readBlock(unsigned char address, unsigned char reg, unsigned char * buffer, int length);
+
+	private:
+		int fd;									// file descriptor for the i2c-dev node
+
+		void open(const std::string & devicePath);
+
+		// Not copyable, the bus owns fd
+		LidarLiteLinuxI2cBus(const LidarLiteLinuxI2cBus &);
+		LidarLiteLinuxI2cBus & operator=(const LidarLiteLinuxI2cBus &);
+};
@@ -0,0 +1,148 @@
+/*
+LidarLiteLog - Compile-time filtered logging into a lock-free trace ring
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteLog.hpp"
+#include "LidarLiteQueue.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+namespace {
+
+const size_t TRACE_CAPACITY = 4096;			// Records, a power of two
+const int FLUSH_INTERVAL_MILLIS = 50;
+const char * LEVEL_NAMES[] = { "", "", "VERBOSE", "DEBUG", "INFO", "WARN", "ERROR", "ASSERT", "NONE" };
+
+// Producers are whichever threads log, the consumer is the flush thread
+typedef LidarLiteQueue<LidarLiteTrace::Record> TraceRing;
+
+// Set once the trace state is torn down at exit. Constant-initialized and
+// trivially destructible, so it can still be read by later static destructors.
+std::atomic<bool> traceDestroyed(false);
+
+// The ring plus the thread that empties it. Stopped, joined and flushed at exit.
+class TraceState
+{
+	public:
+		TraceRing ring;
+
+		TraceState() : ring(TRACE_CAPACITY), stopping(false) {}
+
+		~TraceState() {
+			traceDestroyed.store(true);
+			if (thread.joinable()) {
+				{
+					std::lock_guard<std::mutex> guard(mutex);
+					stopping = true;
+				}
+				wake.notify_all();
+				thread.join();
+			}
+			drain();
+		}
+
+		void startFlushThread() {
+			std::call_once(started, [this]() {
+				thread = std::thread(&TraceState::flushLoop, this);
+			});
+		}
+
+		// Formats every pending record and writes them to cout in one go,
+		// e.g. "[12.345678] DEBUG writeSuccess = 0"
+		void drain() {
+			std::ostringstream out;
+			LidarLiteTrace::Record record;
+			bool any = false;
+			while (ring.pop(record)) {
+				out << "[" << record.timestampNanos / 1000000000ULL << "."
+					<< std::setw(6) << std::setfill('0') << (record.timestampNanos / 1000ULL) % 1000000ULL << "] ";
+				if (record.level >= 0 && record.level <= 8) out << LEVEL_NAMES[record.level] << " ";
+				out << record.message;
+				if (record.valueCount > 0) out << record.values[0];
+				if (record.valueCount > 1) out << ", " << record.values[1];
+				out << "\n";
+				any = true;
+			}
+			if (any) {
+				std::cout << out.str();
+				std::cout.flush();
+			}
+		}
+
+	private:
+		std::once_flag started;
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable wake;
+		bool stopping;
+
+		void flushLoop() {
+			std::unique_lock<std::mutex> guard(mutex);
+			while (!stopping) {
+				wake.wait_for(guard, std::chrono::milliseconds(FLUSH_INTERVAL_MILLIS));
+				guard.unlock();
+				drain();
+				guard.lock();
+			}
+		}
+};
+
+TraceState & traceState() {
+	static TraceState state;
+	return state;
+}
+
+}
+
+// ***************************************************
+// Stores a record, called from the sensor threads
+// ***************************************************
+void LidarLiteTrace::push(int level, const char * message, int valueCount, int value0, int value1) {
+	// Logging from a static destructor after teardown is dropped
+	if (traceDestroyed.load(std::memory_order_relaxed)) return;
+	TraceState & state = traceState();
+	Record record;
+	record.timestampNanos = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	record.level = level;
+	record.message = message;
+	record.values[0] = value0;
+	record.values[1] = value1;
+	record.valueCount = valueCount;
+	state.ring.push(record);
+	state.startFlushThread();
+}
+// END push
+// ***************************************************
+
+// ***************************************************
+// Prints every pending record now
+// ***************************************************
+void LidarLiteTrace::flush() {
+	if (traceDestroyed.load(std::memory_order_relaxed)) return;
+	traceState().drain();
+}
+// END flush
+// ***************************************************
+
+// ***************************************************
+// Records lost to a full ring
+// ***************************************************
+unsigned long LidarLiteTrace::droppedCount() {
+	if (traceDestroyed.load(std::memory_order_relaxed)) return 0;
+	return traceState().ring.dropCount();
+}
+// END droppedCount
+// ***************************************************
@@ -0,0 +1,77 @@
+/*
+LidarLiteLog - Compile-time filtered logging into a lock-free trace ring
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Log calls below LIDARLITE_MIN_LOG_LEVEL compile to nothing: the level is a
+template parameter and disabled levels dispatch to an empty inline overload.
+Enabled calls still honour the runtime LidarLite::logLevel, and instead of
+writing to cout on the calling (sensor) thread they store a fixed-size record
+in a lock-free ring. A background thread formats and prints the records.
+
+Messages must be string literals (only the pointer is stored), with up to two
+integer values appended when printed.
+
+Levels match the LidarLite constants:
+	VERBOSE = 2, DEBUG = 3, INFO = 4, WARN = 5, ERROR = 6, ASSERT = 7, NONE = 8
+Compile with e.g. -DLIDARLITE_MIN_LOG_LEVEL=2 to be able to turn on VERBOSE
+logs at runtime. The default keeps WARN and above.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+#ifndef LIDARLITE_MIN_LOG_LEVEL
+#define LIDARLITE_MIN_LOG_LEVEL 5
+#endif
+
+class LidarLiteTrace
+{
+	public:
+		// A log call, formatted later by the flush thread
+		struct Record {
+			unsigned long long timestampNanos;
+			int level;
+			const char * message;
+			int values[2];
+			int valueCount;
+		};
+
+		// Appends a record without blocking; drops it (see droppedCount) if the ring is full.
+		// Starts the flush thread on first use.
+		static void push(int level, const char * message, int valueCount, int value0, int value1);
+
+		// Prints every pending record now, on the calling thread
+		static void flush();
+
+		// Records dropped because the ring was full
+		static unsigned long droppedCount();
+};
+
+// Whether a level is compiled in
+template <int Level>
+struct LidarLiteLogEnabled
+{
+	static const bool value = (Level >= LIDARLITE_MIN_LOG_LEVEL);
+};
+
+// Dispatch targets for LidarLite::log, the disabled one is empty and inlines away
+template <bool Enabled>
+struct LidarLiteLogDispatch
+{
+	static inline void log(int, int, const char *, int, int, int) {}
+};
+
+template <>
+struct LidarLiteLogDispatch<true>
+{
+	static inline void log(int runtimeLevel, int level, const char * message, int valueCount, int value0, int value1) {
+		if (runtimeLevel <= level) LidarLiteTrace::push(level, message, valueCount, value0, value1);
+	}
+};
@@ -0,0 +1,29 @@
+/*
+LidarLiteModePin - Measurement-complete event source for free-running LidarLites
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+In free-running (repetition) mode the LIDAR Lite v2 signals every completed
+measurement on its MODE pin. Wiring that pin to a GPIO lets the host sleep
+until a result is actually ready instead of guessing with timed reads.
+
+Implementations:
+	- LidarLiteSysfsGpio: a GPIO edge through /sys/class/gpio
+	- LidarLiteSimulator::modePin(): the simulated sensor's completion events
+*/
+
+#pragma once
+
+class LidarLiteModePin
+{
+	public:
+		virtual ~LidarLiteModePin() {}
+
+		// Blocks until the next measurement-complete edge.
+		// Returns 1 on an edge, 0 if timeoutMicros passed first, or -1 on error
+		virtual int waitForEdge(int timeoutMicros) = 0;
+};
@@ -0,0 +1,126 @@
+/*
+LidarLiteQueue - Bounded lock-free multi-producer/multi-consumer queue
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+D. Vyukov's bounded queue. Each cell carries a sequence number telling
+producers and consumers whose turn it is, so a push is one CAS on the head
+plus a release store and never waits on a consumer, and any number of
+threads may push and pop. Storage is allocated once in the constructor.
+
+Use LidarLiteRing instead when there is exactly one producer and one
+consumer; it needs no CAS at all. When the queue is full push() drops the
+new element and counts it.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template <typename T>
+class LidarLiteQueue
+{
+	public:
+		// capacity is rounded up to a power of two
+		LidarLiteQueue(size_t capacity = 1024) : cells(roundUp(capacity)) {
+			mask = cells.size() - 1;
+			for (size_t i = 0; i < cells.size(); i++) cells[i].sequence.store(i, std::memory_order_relaxed);
+			head.store(0, std::memory_order_relaxed);
+			tail.store(0, std::memory_order_relaxed);
+			drops.store(0, std::memory_order_relaxed);
+		}
+
+		// Any thread. Returns false (and counts a drop) if the queue is full.
+		bool push(const T & value) {
+			size_t pos = head.load(std::memory_order_relaxed);
+			while (true) {
+				Cell & cell = cells[pos & mask];
+				size_t seq = cell.sequence.load(std::memory_order_acquire);
+				long diff = (long) seq - (long) pos;
+				if (diff == 0) {
+					if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						cell.value = value;
+						cell.sequence.store(pos + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					drops.fetch_add(1, std::memory_order_relaxed);
+					return false;
+				} else {
+					pos = head.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Any thread. Returns false if the queue is empty.
+		bool pop(T & value) {
+			size_t pos = tail.load(std::memory_order_relaxed);
+			while (true) {
+				Cell & cell = cells[pos & mask];
+				size_t seq = cell.sequence.load(std::memory_order_acquire);
+				long diff = (long) seq - (long) (pos + 1);
+				if (diff == 0) {
+					if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+						value = cell.value;
+						cell.sequence.store(pos + mask + 1, std::memory_order_release);
+						return true;
+					}
+				} else if (diff < 0) {
+					return false;
+				} else {
+					pos = tail.load(std::memory_order_relaxed);
+				}
+			}
+		}
+
+		// Approximate unless producers and consumers are quiet
+		bool empty() {
+			return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire);
+		}
+
+		size_t capacity() {
+			return mask + 1;
+		}
+
+		// Elements dropped because the queue was full
+		unsigned long dropCount() {
+			return drops.load(std::memory_order_relaxed);
+		}
+
+	private:
+		struct Cell {
+			std::atomic<size_t> sequence;
+			T value;
+			Cell() {}
+			// Only needed to size the vector, before any thread touches it
+			Cell(const Cell &) {}
+		};
+
+		static size_t roundUp(size_t capacity) {
+			size_t size = 2;
+			while (size < capacity) size <<= 1;
+			return size;
+		}
+
+		std::vector<Cell> cells;
+		size_t mask;
+		// head and tail a cache line apart so producers and consumers don't false-share,
+		// padded rather than alignas(64) for the same reason as in LidarLiteRing
+		char pad0[64];
+		std::atomic<size_t> head;
+		char pad1[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> tail;
+		char pad2[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<unsigned long> drops;
+		char pad3[64 - sizeof(std::atomic<unsigned long>)];
+
+		// Not copyable
+		LidarLiteQueue(const LidarLiteQueue &);
+		LidarLiteQueue & operator=(const LidarLiteQueue &);
+};
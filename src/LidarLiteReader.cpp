@@ -0,0 +1,602 @@
+/*
+LidarLiteReader - LidarLite with its own acquisition thread, no openFrameworks needed
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteReader.hpp"
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+
+// ***************************************************
+// Constructor
+// ***************************************************
+LidarLiteReader::LidarLiteReader() {
+	running = false;
+	_distance = -1;
+	_signalStrength = -1;
+	_newOutputAvailable = false;
+	_readStarted = false;
+	_schedule = SCHEDULE_ON_DEMAND;
+	_periodNanos = 0;
+	_pipelined = false;
+	_loopActive = false;
+	_continuousRequest = CONTINUOUS_NONE;
+	_continuousRateHz = 0;
+	_continuousStabilize = true;
+	_continuous = false;
+	_sequence = 0;
+	_batchSubmitted = false;
+	_recorderSensor = 0;
+	_streamSensor = 0;
+	_correlationPeriodNanos = 0;
+	_nextCorrelationNanos = 0;
+	_correlationReadNanos = 0;
+	_correlationRecord.size = 0;
+	_samples = new LidarLiteRing<LidarLiteSample>(1024);
+}
+// END Constructor
+// ***************************************************
+
+// ***************************************************
+// Destructor
+// ***************************************************
+LidarLiteReader::~LidarLiteReader() {
+	LidarLiteReader::stop();
+	delete _samples;
+}
+// END Destructor
+// ***************************************************
+
+// ***************************************************
+// Starts the acquisition thread
+// ***************************************************
+void LidarLiteReader::start() {
+	if (running) return;
+	running = true;
+	thread = std::thread(&LidarLiteReader::acquisitionLoop, this);
+}
+
+void LidarLiteReader::stop() {
+	if (!running) return;
+	running = false;
+	wakeAcquisitionLoop();
+	if (thread.joinable()) thread.join();
+}
+
+bool LidarLiteReader::isReading() {
+	return running;
+}
+
+bool LidarLiteReader::keepReading() {
+	return running;
+}
+// END start/stop
+// ***************************************************
+
+// ***************************************************
+// Selects how the thread triggers measurements:
+// - SCHEDULE_ON_DEMAND: once per startDistanceRead(), the thread
+//   sleeps on a condition variable in between
+// - SCHEDULE_FIXED_RATE: at rateHz, on absolute CLOCK_MONOTONIC
+//   deadlines so the rate doesn't drift with measurement time
+// - SCHEDULE_AS_FAST_AS_POSSIBLE: back to back
+// Free-running mode (startContinuous) takes precedence, the
+// sensor then sets the pace.
+// ***************************************************
+void LidarLiteReader::setSchedule(int schedule, float rateHz) {
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		if (schedule == SCHEDULE_FIXED_RATE && rateHz <= 0) schedule = SCHEDULE_AS_FAST_AS_POSSIBLE;
+		_schedule = schedule;
+		_periodNanos = (rateHz > 0) ? (long long) (1e9 / rateHz) : 0;
+	}
+	_wake.notify_all();
+}
+
+int LidarLiteReader::getSchedule() {
+	std::lock_guard<std::mutex> guard(_wakeMutex);
+	return _schedule;
+}
+
+void LidarLiteReader::setPipelined(bool pipelined) {
+	std::lock_guard<std::mutex> guard(_wakeMutex);
+	_pipelined = pipelined;
+}
+// END setSchedule
+// ***************************************************
+
+// ***************************************************
+// Acquisition loop.
+// Measures according to the schedule (see setSchedule),
+// or collects every result in free-running mode (startContinuous).
+// Calling getOutput internally sets isOutputNew() to false.
+// ***************************************************
+void LidarLiteReader::acquisitionLoop() {
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		_loopActive = true;
+	}
+
+	while (keepReading())
+	{
+		LidarLiteStats * stats = activeStats();
+		LidarLiteStageTimer iterationTimer(stats, LidarLiteStats::STAGE_LOOP_ITERATION);
+		
+		// Pick up new batches and close time based ones that are due
+		serviceBatches(NULL);
+		applyContinuousRequest();
+		
+		if (LidarLite::isContinuous()) {
+			// The LidarLite measures on its own, collect every result
+			LidarLiteMeasurement m;
+			bool success = readContinuous(m);
+			publish(success, m);
+			if (!success) usleep(4000);	// Don't spin on a failing bus
+			continue;
+		}
+
+		int schedule;
+		long long periodNanos;
+		bool pipeline;
+		{
+			std::lock_guard<std::mutex> guard(_wakeMutex);
+			schedule = _schedule;
+			periodNanos = _periodNanos;
+			pipeline = _pipelined;
+		}
+		// Only pipeline measurements that follow each other directly, a result
+		// triggered ahead of a wait would be stale by the time it is read
+		pipeline = pipeline && (schedule == SCHEDULE_AS_FAST_AS_POSSIBLE ||
+			(schedule == SCHEDULE_ON_DEMAND && !_batches.empty()));
+		if (!pipeline && isPipelined()) endPipeline();
+
+		if (schedule == SCHEDULE_ON_DEMAND) {
+			// Sleep until startDistanceRead() is called
+			LidarLiteStageTimer waitTimer(stats, LidarLiteStats::STAGE_SCHEDULE_WAIT);
+			if (!waitForReadRequest()) continue;
+		}
+		else if (schedule == SCHEDULE_FIXED_RATE) {
+			// Advance the deadline by one period. If we fell more than a
+			// period behind, restart from now instead of bursting to catch up.
+			struct timespec now;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			long long next = deadline.tv_sec * 1000000000LL + deadline.tv_nsec + periodNanos;
+			long long current = now.tv_sec * 1000000000LL + now.tv_nsec;
+			if (next < current - periodNanos) next = current;
+			deadline.tv_sec = (time_t) (next / 1000000000LL);
+			deadline.tv_nsec = (long) (next % 1000000000LL);
+			LidarLiteStageTimer waitTimer(stats, LidarLiteStats::STAGE_SCHEDULE_WAIT);
+			while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {}
+		}
+
+		// Read distance and signal strength from the LidarLite in one transaction
+		LidarLiteMeasurement m;
+		bool success = pipeline ? measurePipelined(m) : measure(m);
+		publish(success, m);
+		if (success && _correlationCallback && !pipeline) {
+			long long next = 0;
+			if (schedule == SCHEDULE_FIXED_RATE) next = deadline.tv_sec * 1000000000LL + deadline.tv_nsec + periodNanos;
+			captureCorrelation(next);
+		}
+		if (!success && schedule != SCHEDULE_FIXED_RATE) usleep(4000);	// Don't spin on a failing bus
+	}
+	
+	// Leave the sensor idle for whoever uses it next, in the mode last asked for
+	endPipeline();
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		_loopActive = false;
+	}
+	applyContinuousRequest();
+	
+	// Don't leave anyone waiting on a batch that can no longer fill
+	serviceBatches(NULL);
+	for (size_t i = 0; i < _batches.size(); i++) finishBatch(_batches[i]);
+	_batches.clear();
+}
+// END acquisitionLoop
+// ***************************************************
+
+// ***************************************************
+// Blocks until startDistanceRead() is called, a batch is
+// submitted, the schedule changes or the loop is stopped.
+// Returns true if a read was requested or a batch is open.
+// ***************************************************
+bool LidarLiteReader::waitForReadRequest() {
+	if (!_batches.empty()) return true;
+	std::unique_lock<std::mutex> guard(_wakeMutex);
+	while (!_readStarted && !_batchSubmitted && _schedule == SCHEDULE_ON_DEMAND &&
+		_continuousRequest == CONTINUOUS_NONE && keepReading()) {
+		_wake.wait(guard);
+	}
+	if (_batchSubmitted) return true;
+	if (!_readStarted) return false;
+	// Set flag to indicate we've taken the requested read
+	_readStarted = false;
+	return true;
+}
+
+void LidarLiteReader::wakeAcquisitionLoop() {
+	// Taking the mutex orders this with the loop's check of keepReading()
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+	}
+	_wake.notify_all();
+}
+// END waitForReadRequest
+// ***************************************************
+
+// ***************************************************
+// Starts a read from the LidarLite (SCHEDULE_ON_DEMAND only).
+// Returns whether it was successful.
+// ***************************************************
+bool LidarLiteReader::startDistanceRead() {
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		_readStarted = true;
+	}
+	// Wake the thread
+	_wake.notify_one();
+	return true;
+}
+// END startDistanceRead
+// ***************************************************
+
+// ***************************************************
+// Free-running mode. The sensor's registers and the LidarLite's
+// acquisition state belong to the acquisition thread while it
+// runs, so the request is queued for it rather than applied here.
+// ***************************************************
+bool LidarLiteReader::startContinuous(int rateHz, bool stablizePreampFlag) {
+	if (rateHz <= 0) return false;
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		if (!_loopActive) {
+			bool success = LidarLite::startContinuous(rateHz, stablizePreampFlag);
+			_continuous = LidarLite::isContinuous();
+			return success;
+		}
+		_continuousRequest = CONTINUOUS_START;
+		_continuousRateHz = rateHz;
+		_continuousStabilize = stablizePreampFlag;
+		_continuous = true;
+	}
+	_wake.notify_all();
+	return true;
+}
+
+void LidarLiteReader::stopContinuous() {
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		if (!_loopActive) {
+			LidarLite::stopContinuous();
+			_continuous = false;
+			return;
+		}
+		_continuousRequest = CONTINUOUS_STOP;
+		_continuous = false;
+	}
+	_wake.notify_all();
+}
+
+bool LidarLiteReader::isContinuous() {
+	return _continuous;
+}
+
+//--------------------------------------------------------------
+// Acquisition thread side, applies the last request made
+void LidarLiteReader::applyContinuousRequest() {
+	int request;
+	int rateHz;
+	bool stabilize;
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		request = _continuousRequest;
+		rateHz = _continuousRateHz;
+		stabilize = _continuousStabilize;
+		_continuousRequest = CONTINUOUS_NONE;
+	}
+	if (request == CONTINUOUS_START) {
+		if (!LidarLite::startContinuous(rateHz, stabilize)) _continuous = false;
+	} else if (request == CONTINUOUS_STOP) {
+		LidarLite::stopContinuous();
+	}
+}
+// END Free-running mode
+// ***************************************************
+
+// ***************************************************
+// Gets a copy of the latest asynchronously processed output.
+// isOutputNew() will return false after calling getOutput until
+// the thread processes a new output.
+// ***************************************************
+bool LidarLiteReader::getOutput(int & mDistance, int & mSignalStrength) {
+	std::unique_lock<std::mutex> guard(outputMutex, std::defer_lock);
+	{
+		LidarLiteStageTimer timer(activeStats(), LidarLiteStats::STAGE_OUTPUT_LOCK);
+		guard.lock();
+	}
+	mDistance = _distance;
+	mSignalStrength = _signalStrength;
+	// Set flag to indicate a new output is NOT available
+	_newOutputAvailable = false;
+	return true;
+}
+
+bool LidarLiteReader::isOutputNew() {
+	return _newOutputAvailable;
+}
+// END getOutput
+// ***************************************************
+
+// ***************************************************
+// Filters a result, appends it to the sample ring and
+// publishes it as the latest output.
+// ***************************************************
+void LidarLiteReader::publish(bool success, const LidarLiteMeasurement & m) {
+	LidarLiteSample sample;
+	if (success) {
+		makeSample(m, sample);
+		if (_filter) _filter->process(sample);
+		_samples->push(sample);
+		if (_recorder) _recorder->record(sample, _recorderSensor);
+		if (_sharedMemory) _sharedMemory->publish(sample);
+		if (_streamServer) _streamServer->publish(sample, _streamSensor);
+		serviceBatches(&sample);
+	}
+	if (_statusMonitor) _statusMonitor->record(success ? m.status : -1);
+	std::unique_lock<std::mutex> guard(outputMutex, std::defer_lock);
+	{
+		LidarLiteStageTimer timer(activeStats(), LidarLiteStats::STAGE_OUTPUT_LOCK);
+		guard.lock();
+	}
+	_distance = success ? sample.distance : -1;
+	_signalStrength = success ? m.signalStrength : -1;
+	_newOutputAvailable = true;
+}
+// END publish
+// ***************************************************
+
+// ***************************************************
+// Timestamps a measurement and numbers it.
+// Called only from the acquisition loop, the ring's single producer.
+// ***************************************************
+void LidarLiteReader::makeSample(const LidarLiteMeasurement & m, LidarLiteSample & sample) {
+	sample.distance = m.distance;
+	sample.rawDistance = m.distance;
+	sample.signalStrength = m.signalStrength;
+	sample.status = m.status;
+	sample.velocity = m.velocity;
+	sample.timestampNanos = chrono::duration_cast<chrono::nanoseconds>(
+		chrono::steady_clock::now().time_since_epoch()).count();
+	sample.sequence = _sequence++;
+}
+// END makeSample
+// ***************************************************
+
+// ***************************************************
+// Correlation capture. Runs right after a measurement, while
+// the record still belongs to it. nextMeasurementNanos is when
+// the schedule wants the next measurement, 0 if it doesn't care.
+// ***************************************************
+void LidarLiteReader::setCorrelationCapture(float rateHz, CorrelationCallback callback) {
+	if (keepReading()) return;
+	_correlationPeriodNanos = (rateHz > 0) ? (long long) (1e9 / rateHz) : 0;
+	_correlationCallback = (rateHz > 0) ? callback : CorrelationCallback();
+	_nextCorrelationNanos = 0;
+}
+
+void LidarLiteReader::captureCorrelation(long long nextMeasurementNanos) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	long long now = ts.tv_sec * 1000000000LL + ts.tv_nsec;
+	if (now < _nextCorrelationNanos) return;
+	// Wait for a gap long enough, based on the last capture
+	if (nextMeasurementNanos > 0 && now + _correlationReadNanos > nextMeasurementNanos) return;
+	
+	LidarLiteStageTimer timer(activeStats(), LidarLiteStats::STAGE_CORRELATION_READ);
+	bool success = readCorrelationRecord(_correlationRecord);
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	_correlationReadNanos = ts.tv_sec * 1000000000LL + ts.tv_nsec - now;
+	// Keep to the rate on average, without bursting after a long gap
+	if (now - _nextCorrelationNanos > _correlationPeriodNanos) _nextCorrelationNanos = now;
+	_nextCorrelationNanos += _correlationPeriodNanos;
+	if (!success) return;
+	
+	_correlationRecord.sequence = _sequence - 1;
+	LidarLiteCorrelationPeaks peaks = LidarLiteCorrelation::analyze(_correlationRecord.values, _correlationRecord.size);
+	_correlationCallback(_correlationRecord, peaks);
+}
+// END captureCorrelation
+// ***************************************************
+
+// ***************************************************
+// Batched reads. The acquisition thread appends each sample to
+// every open batch and hands a batch over in one piece when it
+// is full or its time is up, so the consumer synchronizes once
+// per batch instead of once per sample.
+// ***************************************************
+void LidarLiteReader::readBatch(size_t count, BatchCallback callback) {
+	Batch batch;
+	batch.count = (count > 0) ? count : 1;
+	batch.untilNanos = 0;
+	batch.callback = callback;
+	submitBatch(batch);
+}
+
+void LidarLiteReader::readFor(int millis, BatchCallback callback) {
+	Batch batch;
+	batch.count = 0;
+	batch.untilNanos = chrono::duration_cast<chrono::nanoseconds>(
+		(chrono::steady_clock::now() + chrono::milliseconds(millis)).time_since_epoch()).count();
+	batch.callback = callback;
+	submitBatch(batch);
+}
+
+std::future< vector<LidarLiteSample> > LidarLiteReader::readBatch(size_t count) {
+	Batch batch;
+	batch.count = (count > 0) ? count : 1;
+	batch.untilNanos = 0;
+	batch.promise = make_shared< std::promise< vector<LidarLiteSample> > >();
+	std::future< vector<LidarLiteSample> > result = batch.promise->get_future();
+	submitBatch(batch);
+	return result;
+}
+
+std::future< vector<LidarLiteSample> > LidarLiteReader::readFor(int millis) {
+	Batch batch;
+	batch.count = 0;
+	batch.untilNanos = chrono::duration_cast<chrono::nanoseconds>(
+		(chrono::steady_clock::now() + chrono::milliseconds(millis)).time_since_epoch()).count();
+	batch.promise = make_shared< std::promise< vector<LidarLiteSample> > >();
+	std::future< vector<LidarLiteSample> > result = batch.promise->get_future();
+	submitBatch(batch);
+	return result;
+}
+
+void LidarLiteReader::submitBatch(Batch & batch) {
+	// Size the buffer here so the acquisition thread doesn't allocate per sample
+	if (batch.count > 0) batch.samples.reserve(batch.count);
+	{
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		_submittedBatches.push_back(std::move(batch));
+		_batchSubmitted = true;
+	}
+	_wake.notify_one();
+}
+
+//--------------------------------------------------------------
+// Called by the acquisition thread with each new sample, and with
+// NULL once per loop to adopt new batches and check deadlines
+void LidarLiteReader::serviceBatches(const LidarLiteSample * sample) {
+	if (_batchSubmitted) {
+		std::lock_guard<std::mutex> guard(_wakeMutex);
+		for (size_t i = 0; i < _submittedBatches.size(); i++) {
+			_batches.push_back(std::move(_submittedBatches[i]));
+		}
+		_submittedBatches.clear();
+		_batchSubmitted = false;
+	}
+	if (_batches.empty()) return;
+	
+	unsigned long long now = sample ? sample->timestampNanos :
+		chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+	size_t i = 0;
+	while (i < _batches.size()) {
+		Batch & batch = _batches[i];
+		bool done;
+		if (batch.count > 0) {
+			if (sample) batch.samples.push_back(*sample);
+			done = (batch.samples.size() >= batch.count);
+		} else {
+			if (sample && sample->timestampNanos <= batch.untilNanos) batch.samples.push_back(*sample);
+			done = (now >= batch.untilNanos);
+		}
+		if (done) {
+			finishBatch(batch);
+			_batches.erase(_batches.begin() + i);
+		} else {
+			i++;
+		}
+	}
+}
+
+void LidarLiteReader::finishBatch(Batch & batch) {
+	if (batch.callback) batch.callback(batch.samples.data(), batch.samples.size());
+	if (batch.promise) batch.promise->set_value(std::move(batch.samples));
+}
+// END readBatch
+// ***************************************************
+
+// ***************************************************
+// Resizes the sample ring. Not thread safe, call before start().
+// ***************************************************
+void LidarLiteReader::setSampleBufferSize(size_t capacity) {
+	if (keepReading()) return;
+	delete _samples;
+	_samples = new LidarLiteRing<LidarLiteSample>(capacity);
+}
+// END setSampleBufferSize
+// ***************************************************
+
+// ***************************************************
+// Installs the filter run on every sample. Not thread safe, call before start().
+// ***************************************************
+void LidarLiteReader::setFilter(shared_ptr<LidarLiteFilter> filter) {
+	if (keepReading()) return;
+	if (filter) filter->reset();
+	_filter = filter;
+}
+// END setFilter
+// ***************************************************
+
+// ***************************************************
+// Installs the recorder fed every sample. Not thread safe, call before start().
+// ***************************************************
+void LidarLiteReader::setRecorder(shared_ptr<LidarLiteRecorder> recorder, int sensor) {
+	if (keepReading()) return;
+	_recorder = recorder;
+	_recorderSensor = sensor;
+}
+// END setRecorder
+// ***************************************************
+
+// ***************************************************
+// Installs the shared memory segment every sample is published to.
+// Not thread safe, call before start().
+// ***************************************************
+void LidarLiteReader::setSharedMemory(shared_ptr<LidarLiteSharedMemoryPublisher> publisher) {
+	if (keepReading()) return;
+	_sharedMemory = publisher;
+}
+// END setSharedMemory
+// ***************************************************
+
+// ***************************************************
+// Installs the stream server every sample is handed to.
+// Not thread safe, call before start().
+// ***************************************************
+void LidarLiteReader::setStreamServer(shared_ptr<LidarLiteStreamServer> server, int sensor) {
+	if (keepReading()) return;
+	_streamServer = server;
+	_streamSensor = sensor;
+}
+// END setStreamServer
+// ***************************************************
+
+// ***************************************************
+// Installs the status monitor fed every measurement's status.
+// Not thread safe, call before start().
+// ***************************************************
+void LidarLiteReader::setStatusMonitor(shared_ptr<LidarLiteStatusMonitor> monitor) {
+	if (keepReading()) return;
+	_statusMonitor = monitor;
+}
+// END setStatusMonitor
+// ***************************************************
+
+// ***************************************************
+// Copies out the oldest samples without blocking the thread.
+// Only one consumer thread may call drain().
+// ***************************************************
+size_t LidarLiteReader::drain(LidarLiteSample * samples, size_t maxSamples) {
+	return _samples->drain(samples, maxSamples);
+}
+
+size_t LidarLiteReader::drain(vector<LidarLiteSample> & samples) {
+	return _samples->drain(samples);
+}
+
+unsigned long LidarLiteReader::overrunCount() {
+	return _samples->overrunCount();
+}
+// END drain
+// ***************************************************
@@ -0,0 +1,194 @@
+/*
+LidarLiteReader - LidarLite with its own acquisition thread, no openFrameworks needed
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Runs the acquisition loop on a std::thread so headless programs can read the
+sensor without the openFrameworks runtime. ThreadedLidarLite is the
+openFrameworks flavour of the same loop running on an ofThread.
+
+Example Usage
+------------------------------------------------------------------------------
+	LidarLiteReader lidar;
+	lidar.begin();
+	lidar.setSchedule(LidarLiteReader::SCHEDULE_FIXED_RATE, 200);
+	lidar.start();
+	vector<LidarLiteSample> samples;
+	while (true) {
+		usleep(100000);
+		lidar.drain(samples);
+		...
+	}
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include "LidarLiteRing.hpp"
+#include "LidarLiteFilter.hpp"
+#include "LidarLiteRecording.hpp"
+#include "LidarLiteCorrelation.hpp"
+#include "LidarLiteStatus.hpp"
+#include "LidarLiteSharedMemory.hpp"
+#include "LidarLiteStreamServer.hpp"
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <vector>
+
+class LidarLiteReader : public LidarLite
+{
+	public:
+		// Acquisition scheduling modes, see setSchedule()
+		static const int SCHEDULE_ON_DEMAND = 0;			// One measurement per startDistanceRead() (default)
+		static const int SCHEDULE_FIXED_RATE = 1;			// Measure at a target rate independent of the caller
+		static const int SCHEDULE_AS_FAST_AS_POSSIBLE = 2;	// Measure back to back
+
+		LidarLiteReader();
+		virtual ~LidarLiteReader();
+
+		virtual void start();					// Start the acquisition thread
+		virtual void stop();					// Stop the acquisition thread
+		bool isReading();						// Returns whether the acquisition thread is running
+
+		void setSchedule(int schedule, float rateHz = 0);	// Select how the thread triggers measurements
+		int getSchedule();
+
+		// Trigger each measurement as soon as the previous result is read (see LidarLite::measurePipelined),
+		// so publishing a sample overlaps the next acquisition. Applies while measuring back to back:
+		// SCHEDULE_AS_FAST_AS_POSSIBLE, and SCHEDULE_ON_DEMAND while a batch is open. Correlation capture
+		// is skipped meanwhile, the sensor is always busy with the next measurement.
+		void setPipelined(bool pipelined);
+
+		bool startDistanceRead();				// initiates a distance and signal strength read (not needed after startContinuous)
+
+		// Free-running mode (see LidarLite::startContinuous). While the acquisition thread runs the
+		// change is handed to it and applied between measurements, so it never races the
+		// thread's bus traffic; startContinuous() then only fails for rateHz <= 0.
+		bool startContinuous(int rateHz, bool stablizePreampFlag = true);
+		void stopContinuous();
+		bool isContinuous();					// Whether free-running mode is on or requested
+		bool isOutputNew();						// Returns whether new output data is available
+		bool getOutput(int & distance, int & signalStrength);
+
+		// Lock-free access to every sample taken, not just the latest one
+		void setSampleBufferSize(size_t capacity);	// Call before start(), defaults to 1024 samples
+		size_t drain(LidarLiteSample * samples, size_t maxSamples);	// Copies out up to maxSamples oldest samples
+		size_t drain(vector<LidarLiteSample> & samples);				// Appends every waiting sample
+		unsigned long overrunCount();			// Samples dropped because drain() wasn't called often enough
+
+		// Batched reads, delivered once complete as one contiguous block. In SCHEDULE_ON_DEMAND the
+		// thread measures back to back while a batch is open, otherwise batches follow the schedule.
+		// Callbacks run on the acquisition thread; batches still open at stop() are delivered short.
+		typedef std::function<void(const LidarLiteSample * samples, size_t count)> BatchCallback;
+		void readBatch(size_t count, BatchCallback callback);				// The next count samples
+		void readFor(int millis, BatchCallback callback);					// Every sample taken in the next millis
+		std::future< vector<LidarLiteSample> > readBatch(size_t count);
+		std::future< vector<LidarLiteSample> > readFor(int millis);
+
+		// Filter applied on the acquisition thread to every sample before it is published.
+		// Call before start(); pass an empty pointer to publish raw distances.
+		void setFilter(shared_ptr<LidarLiteFilter> filter);
+
+		// Appends every sample to a binary recording from the acquisition thread, tagged with sensor.
+		// Call before start(); close the recorder after stop().
+		void setRecorder(shared_ptr<LidarLiteRecorder> recorder, int sensor = 0);
+
+		// Publishes every sample to other processes through shared memory from the acquisition
+		// thread. Call before start().
+		void setSharedMemory(shared_ptr<LidarLiteSharedMemoryPublisher> publisher);
+
+		// Hands every sample, tagged with sensor, to a running stream server from the acquisition
+		// thread; the server thread does the socket work. Call before start().
+		void setStreamServer(shared_ptr<LidarLiteStreamServer> server, int sensor = 0);
+
+		// Feeds the status byte of every measurement (-1 when it failed) to monitor from the acquisition
+		// thread. Call before start(); the counters can be read from any thread meanwhile.
+		void setStatusMonitor(shared_ptr<LidarLiteStatusMonitor> monitor);
+
+		// Reads the correlation record after a successful measurement, at most rateHz, into a record
+		// allocated once, analyzes it and passes both to callback on the acquisition thread. Under
+		// SCHEDULE_FIXED_RATE a capture is put off while it wouldn't finish before the next measurement
+		// is due, so captures never delay sampling. Not done in free-running mode.
+		// Call before start(); rateHz 0 turns capture off.
+		typedef std::function<void(const LidarLiteCorrelationRecord & record, const LidarLiteCorrelationPeaks & peaks)> CorrelationCallback;
+		void setCorrelationCapture(float rateHz, CorrelationCallback callback);
+
+	protected:
+		// The acquisition loop, returns once keepReading() turns false
+		void acquisitionLoop();
+
+		// Whether acquisitionLoop() should continue, overridden by thread wrappers
+		virtual bool keepReading();
+
+		// Wakes the loop if it is waiting for a read request, e.g. so it notices it should stop
+		void wakeAcquisitionLoop();
+
+	private:
+		std::thread thread;
+		std::atomic<bool> running;
+		std::mutex outputMutex;					// Guards the latest output
+		int _distance;							// Stores the output locally to permit thread-safe processing
+		int _signalStrength;					// Stores the output locally to permit thread-safe processing
+		std::atomic<bool> _newOutputAvailable;	// Tracks whether a new output is available from getOutput()
+		bool _readStarted;						// Tracks whether a read has been requested, guarded by _wakeMutex
+		int _schedule;							// One of the SCHEDULE_ constants
+		long long _periodNanos;					// Measurement period for SCHEDULE_FIXED_RATE
+		bool _pipelined;						// Whether back to back measurements are pipelined
+		bool _loopActive;						// Whether acquisitionLoop() is running, guarded by _wakeMutex
+		int _continuousRequest;					// One of the CONTINUOUS_ constants, guarded by _wakeMutex
+		int _continuousRateHz;					// For CONTINUOUS_START, guarded by _wakeMutex
+		bool _continuousStabilize;
+		std::atomic<bool> _continuous;			// Free-running mode as last applied or requested
+		std::mutex _wakeMutex;					// Guards _readStarted, _schedule and _pipelined changes
+		std::condition_variable _wake;			// Wakes the thread for on-demand reads and schedule changes
+		unsigned int _sequence;					// Sequence number of the next sample
+		LidarLiteRing<LidarLiteSample> * _samples;	// Every sample in order, filled by the thread, emptied by drain()
+		shared_ptr<LidarLiteFilter> _filter;	// Optional, run on every sample by the thread
+		shared_ptr<LidarLiteRecorder> _recorder;	// Optional, fed every sample by the thread
+		int _recorderSensor;					// Sensor id written to the recording
+		shared_ptr<LidarLiteSharedMemoryPublisher> _sharedMemory;	// Optional, fed every sample by the thread
+		shared_ptr<LidarLiteStreamServer> _streamServer;	// Optional, fed every sample by the thread
+		int _streamSensor;						// Sensor id sent to subscribers
+		shared_ptr<LidarLiteStatusMonitor> _statusMonitor;	// Optional, fed every status byte by the thread
+		CorrelationCallback _correlationCallback;	// Optional, gets every captured correlation record
+		long long _correlationPeriodNanos;		// Minimum time between correlation captures
+		long long _nextCorrelationNanos;		// CLOCK_MONOTONIC time the next capture is allowed
+		long long _correlationReadNanos;		// How long the last capture took
+		LidarLiteCorrelationRecord _correlationRecord;	// Reused for every capture
+
+		struct Batch {
+			size_t count;						// Samples wanted, 0 if time based
+			unsigned long long untilNanos;		// steady_clock deadline, 0 if count based
+			vector<LidarLiteSample> samples;
+			BatchCallback callback;
+			shared_ptr< std::promise< vector<LidarLiteSample> > > promise;
+		};
+		vector<Batch> _submittedBatches;		// Guarded by _wakeMutex
+		std::atomic<bool> _batchSubmitted;		// Whether _submittedBatches is worth locking for
+		vector<Batch> _batches;					// Open batches, acquisition thread only
+
+		static const int CONTINUOUS_NONE = 0;	// No change of free-running mode pending
+		static const int CONTINUOUS_START = 1;
+		static const int CONTINUOUS_STOP = 2;
+
+		bool waitForReadRequest();
+		void applyContinuousRequest();
+		void submitBatch(Batch & batch);
+		void serviceBatches(const LidarLiteSample * sample);
+		void finishBatch(Batch & batch);
+		void publish(bool success, const LidarLiteMeasurement & m);
+		void makeSample(const LidarLiteMeasurement & m, LidarLiteSample & sample);
+		void captureCorrelation(long long nextMeasurementNanos);
+
+		// Not copyable, owns a thread
+		LidarLiteReader(const LidarLiteReader &);
+		LidarLiteReader & operator=(const LidarLiteReader &);
+};
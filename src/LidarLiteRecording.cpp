@@ -0,0 +1,268 @@
+/*
+LidarLiteRecording - Compact binary sample log, its writer and a zero-copy reader
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteRecording.hpp"
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+static_assert(sizeof(LidarLiteRecordingHeader) == 16, "LidarLiteRecordingHeader layout");
+static_assert(sizeof(LidarLiteBlockHeader) == 16, "LidarLiteBlockHeader layout");
+static_assert(sizeof(LidarLiteRecord) == 32, "LidarLiteRecord layout");
+
+static const char RECORDING_MAGIC[4] = { 'L', 'L', 'R', 'C' };
+static const char BLOCK_MAGIC[4] = { 'L', 'L', 'B', 'K' };
+
+// ***************************************************
+// LidarLiteRecorder
+// ***************************************************
+LidarLiteRecorder::LidarLiteRecorder(const std::string & path, int blockSize) {
+	this->blockSize = (blockSize > 0) ? blockSize : 1;
+	block.reserve(this->blockSize);
+	records = 0;
+
+	fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) return;
+
+	LidarLiteRecordingHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, RECORDING_MAGIC, 4);
+	header.version = VERSION;
+	header.recordSize = sizeof(LidarLiteRecord);
+	header.blockSize = (uint32_t) this->blockSize;
+	if (::write(fd, &header, sizeof(header)) != (ssize_t) sizeof(header)) {
+		::close(fd);
+		fd = -1;
+	}
+}
+
+LidarLiteRecorder::~LidarLiteRecorder() {
+	close();
+}
+
+bool LidarLiteRecorder::isOpen() {
+	return (fd > -1);
+}
+
+bool LidarLiteRecorder::record(const LidarLiteSample & sample, int sensor) {
+	if (fd < 0) return false;
+
+	LidarLiteRecord r;
+	makeRecord(sample, sensor, r);
+	block.push_back(r);
+	records++;
+
+	if (block.size() >= blockSize) return flush();
+	return true;
+}
+
+//--------------------------------------------------------------
+void LidarLiteRecorder::makeRecord(const LidarLiteSample & sample, int sensor, LidarLiteRecord & r) {
+	memset(&r, 0, sizeof(r));
+	r.timestampNanos = sample.timestampNanos;
+	r.sequence = sample.sequence;
+	r.distance = sample.distance;
+	r.rawDistance = sample.rawDistance;
+	r.status = (int16_t) sample.status;
+	r.sensor = (uint16_t) sensor;
+	r.signalStrength = (uint8_t) sample.signalStrength;
+	r.velocity = (int16_t) (sample.velocity < -32768 ? -32768 : (sample.velocity > 32767 ? 32767 : sample.velocity));
+}
+
+//--------------------------------------------------------------
+// Header and records go out in one writev() so a crash leaves at
+// worst one truncated block at the end of the file
+bool LidarLiteRecorder::flush() {
+	if (fd < 0) return false;
+	if (block.empty()) return true;
+
+	LidarLiteBlockHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, BLOCK_MAGIC, 4);
+	header.recordCount = (uint32_t) block.size();
+	header.crc = LidarLiteRecordingReader::crc32(block.data(), block.size() * sizeof(LidarLiteRecord));
+
+	struct iovec iov[2];
+	iov[0].iov_base = &header;
+	iov[0].iov_len = sizeof(header);
+	iov[1].iov_base = block.data();
+	iov[1].iov_len = block.size() * sizeof(LidarLiteRecord);
+	ssize_t expected = (ssize_t) (iov[0].iov_len + iov[1].iov_len);
+	block.clear();
+
+	if (::writev(fd, iov, 2) != expected) {
+		::close(fd);
+		fd = -1;
+		return false;
+	}
+	return true;
+}
+
+void LidarLiteRecorder::close() {
+	if (fd < 0) return;
+	flush();
+	if (fd > -1) ::close(fd);
+	fd = -1;
+}
+
+unsigned long LidarLiteRecorder::recordCount() {
+	return records;
+}
+// END LidarLiteRecorder
+// ***************************************************
+
+// ***************************************************
+// LidarLiteRecordingReader
+// ***************************************************
+LidarLiteRecordingReader::LidarLiteRecordingReader(const std::string & path) {
+	data = NULL;
+	length = 0;
+	records = 0;
+	corruptBlocks = 0;
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(LidarLiteRecordingHeader)) {
+		void * mapping = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping != MAP_FAILED) {
+			data = (const unsigned char *) mapping;
+			length = (size_t) st.st_size;
+		}
+	}
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (!data) return;
+
+	const LidarLiteRecordingHeader * header = (const LidarLiteRecordingHeader *) data;
+	if (memcmp(header->magic, RECORDING_MAGIC, 4) != 0 || header->version != LidarLiteRecorder::VERSION ||
+		header->recordSize != sizeof(LidarLiteRecord)) {
+		munmap((void *) data, length);
+		data = NULL;
+		return;
+	}
+	madvise((void *) data, length, MADV_SEQUENTIAL);
+	index();
+}
+
+LidarLiteRecordingReader::~LidarLiteRecordingReader() {
+	if (data) munmap((void *) data, length);
+}
+
+bool LidarLiteRecordingReader::isOpen() {
+	return (data != NULL);
+}
+
+//--------------------------------------------------------------
+// Walks the block headers once, checking each block's CRC. A bad
+// block header means the rest of the file can't be framed, so
+// indexing stops there.
+void LidarLiteRecordingReader::index() {
+	size_t offset = sizeof(LidarLiteRecordingHeader);
+	while (offset + sizeof(LidarLiteBlockHeader) <= length) {
+		const LidarLiteBlockHeader * header = (const LidarLiteBlockHeader *) (data + offset);
+		if (memcmp(header->magic, BLOCK_MAGIC, 4) != 0) {
+			corruptBlocks++;
+			return;
+		}
+		offset += sizeof(LidarLiteBlockHeader);
+		size_t bytes = (size_t) header->recordCount * sizeof(LidarLiteRecord);
+		if (bytes > length - offset) {
+			// Truncated, e.g. the recorder was killed mid-write
+			corruptBlocks++;
+			return;
+		}
+		if (crc32(data + offset, bytes) == header->crc) {
+			Block b;
+			b.records = (const LidarLiteRecord *) (data + offset);
+			b.count = header->recordCount;
+			b.firstIndex = records;
+			blocks.push_back(b);
+			records += b.count;
+		} else {
+			corruptBlocks++;
+		}
+		offset += bytes;
+	}
+	if (offset != length) corruptBlocks++;
+}
+
+// What record() returns for an index past the end: nothing read, no distance
+static LidarLiteRecord makeInvalidRecord() {
+	LidarLiteRecord r;
+	memset(&r, 0, sizeof(r));
+	r.distance = -1;
+	r.rawDistance = -1;
+	r.status = -1;
+	return r;
+}
+
+static const LidarLiteRecord & invalidRecord() {
+	static const LidarLiteRecord invalid = makeInvalidRecord();
+	return invalid;
+}
+
+size_t LidarLiteRecordingReader::recordCount() {
+	return records;
+}
+
+//--------------------------------------------------------------
+// Binary search for the block holding index
+const LidarLiteRecord & LidarLiteRecordingReader::record(size_t index) {
+	if (index >= records || blocks.empty()) return invalidRecord();
+	size_t lo = 0;
+	size_t hi = blocks.size();
+	while (hi - lo > 1) {
+		size_t mid = (lo + hi) / 2;
+		if (blocks[mid].firstIndex <= index) lo = mid;
+		else hi = mid;
+	}
+	return blocks[lo].records[index - blocks[lo].firstIndex];
+}
+
+size_t LidarLiteRecordingReader::blockCount() {
+	return blocks.size();
+}
+
+const LidarLiteRecord * LidarLiteRecordingReader::block(size_t index, size_t & count) {
+	count = blocks[index].count;
+	return blocks[index].records;
+}
+
+size_t LidarLiteRecordingReader::corruptBlockCount() {
+	return corruptBlocks;
+}
+
+//--------------------------------------------------------------
+uint32_t LidarLiteRecordingReader::crc32(const void * data, size_t length) {
+	struct Table {
+		uint32_t entries[256];
+		Table() {
+			for (uint32_t i = 0; i < 256; i++) {
+				uint32_t c = i;
+				for (int k = 0; k < 8; k++) c = (c & 1) ? 0xedb88320u ^ (c >> 1) : (c >> 1);
+				entries[i] = c;
+			}
+		}
+	};
+	static const Table table;
+
+	const unsigned char * bytes = (const unsigned char *) data;
+	uint32_t crc = 0xffffffffu;
+	for (size_t i = 0; i < length; i++) {
+		crc = table.entries[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc ^ 0xffffffffu;
+}
+// END LidarLiteRecordingReader
+// ***************************************************
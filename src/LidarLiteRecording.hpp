@@ -0,0 +1,158 @@
+/*
+LidarLiteRecording - Compact binary sample log, its writer and a zero-copy reader
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+File layout (host byte order, little-endian on the Raspberry Pi):
+	LidarLiteRecordingHeader								16 bytes, once
+	{ LidarLiteBlockHeader, LidarLiteRecord[recordCount] }	repeated
+Each block header carries the CRC-32 of its records, so a truncated or
+damaged block is detected and skipped without losing the rest of the file.
+Records are fixed-size and 8-byte aligned within the file, so the reader maps
+the file and hands out pointers straight into it.
+
+LidarLiteRecorder is fed from the acquisition thread (see
+LidarLiteReader::setRecorder) and writes one block per blockSize samples.
+LidarLiteReplayBus plays a recording back through the LidarLite API.
+
+Example Usage
+------------------------------------------------------------------------------
+	shared_ptr<LidarLiteRecorder> recorder(new LidarLiteRecorder("run.llr"));
+	myLidarLite.setRecorder(recorder);
+	myLidarLite.start();
+	...
+	myLidarLite.stop();
+	recorder->close();
+
+	LidarLiteRecordingReader recording("run.llr");
+	for (size_t i = 0; i < recording.recordCount(); i++) {
+		const LidarLiteRecord & r = recording.record(i);
+		...
+	}
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct LidarLiteRecordingHeader
+{
+	char magic[4];						// "LLRC"
+	uint16_t version;					// LidarLiteRecorder::VERSION
+	uint16_t recordSize;				// sizeof(LidarLiteRecord)
+	uint32_t blockSize;					// Records per full block
+	uint32_t reserved;
+};
+
+struct LidarLiteBlockHeader
+{
+	char magic[4];						// "LLBK"
+	uint32_t recordCount;				// Records following this header
+	uint32_t crc;						// CRC-32 of the records
+	uint32_t reserved;
+};
+
+struct LidarLiteRecord
+{
+	uint64_t timestampNanos;			// steady_clock time the result was read
+	uint32_t sequence;					// LidarLiteSample::sequence
+	int32_t distance;					// cm, after filtering, -1 if rejected
+	int32_t rawDistance;				// cm, as read from the LidarLite
+	int16_t status;						// Status byte, -1 if not read
+	uint16_t sensor;					// Caller supplied sensor id
+	uint8_t signalStrength;				// 0-255
+	uint8_t reserved0;
+	int16_t velocity;					// cm/s, 0 unless in velocity mode (and in files from before it)
+	uint8_t reserved[4];
+};
+
+class LidarLiteRecorder
+{
+	public:
+		static const int VERSION = 1;
+
+		// Creates (truncates) path and writes the file header
+		LidarLiteRecorder(const std::string & path, int blockSize = 256);
+		~LidarLiteRecorder();
+
+		// Returns whether the file is open and the last write succeeded
+		bool isOpen();
+
+		// Appends a sample, writing out a block once blockSize samples are buffered.
+		// Call from one thread at a time.
+		bool record(const LidarLiteSample & sample, int sensor = 0);
+
+		// Writes out the buffered samples as a short block
+		bool flush();
+
+		// Flushes and closes the file
+		void close();
+
+		// Samples written or buffered
+		unsigned long recordCount();
+
+		// Packs a sample into the file's record layout, also used on the wire by LidarLiteStreamServer
+		static void makeRecord(const LidarLiteSample & sample, int sensor, LidarLiteRecord & record);
+
+	private:
+		int fd;
+		size_t blockSize;
+		vector<LidarLiteRecord> block;			// Samples not yet written, reserved to blockSize
+		unsigned long records;
+
+		// Not copyable, owns fd
+		LidarLiteRecorder(const LidarLiteRecorder &);
+		LidarLiteRecorder & operator=(const LidarLiteRecorder &);
+};
+
+class LidarLiteRecordingReader
+{
+	public:
+		// Maps path and checks every block
+		LidarLiteRecordingReader(const std::string & path);
+		~LidarLiteRecordingReader();
+
+		// Returns whether the file was mapped and has a valid header
+		bool isOpen();
+
+		// Records in the valid blocks. An index past recordCount() gives a record
+		// with status, distance and rawDistance -1.
+		size_t recordCount();
+		const LidarLiteRecord & record(size_t index);
+
+		// Valid blocks, each a contiguous run of records inside the mapping
+		size_t blockCount();
+		const LidarLiteRecord * block(size_t index, size_t & count);
+
+		// Blocks skipped because of a bad header, bad checksum or truncation
+		size_t corruptBlockCount();
+
+		// CRC-32 (IEEE 802.3) as stored in LidarLiteBlockHeader::crc
+		static uint32_t crc32(const void * data, size_t length);
+
+	private:
+		struct Block {
+			const LidarLiteRecord * records;
+			size_t count;
+			size_t firstIndex;					// Index of records[0] across the recording
+		};
+
+		const unsigned char * data;				// The mapping, NULL if not open
+		size_t length;
+		vector<Block> blocks;
+		size_t records;
+		size_t corruptBlocks;
+
+		void index();
+
+		// Not copyable, owns the mapping
+		LidarLiteRecordingReader(const LidarLiteRecordingReader &);
+		LidarLiteRecordingReader & operator=(const LidarLiteRecordingReader &);
+};
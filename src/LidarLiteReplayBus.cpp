@@ -0,0 +1,136 @@
+/*
+LidarLiteReplayBus - Plays a LidarLiteRecording back as a LIDAR Lite on a virtual I2C bus
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteReplayBus.hpp"
+#include "LidarLite.hpp"
+#include <cstring>
+
+//--------------------------------------------------------------
+LidarLiteReplayBus::LidarLiteReplayBus(shared_ptr<LidarLiteRecordingReader> recording, int sensor,
+	float speed, unsigned char address) {
+	this->recording = recording;
+	this->sensor = sensor;
+	this->speed = (speed > 0) ? speed : 0;
+	this->address = address;
+	next = 0;
+	played = 0;
+	started = false;
+	firstTimestampNanos = 0;
+	finished = !recording || !recording->isOpen();
+	busyUntil = Clock::now();
+	memset(registers, 0, sizeof(registers));
+	registers[0x41] = 21;		// LIDAR Lite v2 hardware
+	registers[0x4f] = 9;
+}
+
+//--------------------------------------------------------------
+bool LidarLiteReplayBus::isFinished() {
+	std::lock_guard<std::mutex> guard(mutex);
+	return finished;
+}
+
+//--------------------------------------------------------------
+size_t LidarLiteReplayBus::playedCount() {
+	std::lock_guard<std::mutex> guard(mutex);
+	return played;
+}
+
+//--------------------------------------------------------------
+bool LidarLiteReplayBus::isOpen() {
+	return recording && recording->isOpen();
+}
+
+/* =============================================================================
+  loadNext
+  Latches the next selected record into the result registers and sets the
+  busy flag until it is due. Returns false at the end of the recording.
+============================================================================= */
+bool LidarLiteReplayBus::loadNext() {
+	size_t count = recording->recordCount();
+	while (next < count && sensor >= 0 && recording->record(next).sensor != sensor) next++;
+	if (next >= count) {
+		finished = true;
+		return false;
+	}
+	const LidarLiteRecord & r = recording->record(next++);
+	played++;
+
+	Clock::time_point now = Clock::now();
+	if (!started) {
+		started = true;
+		origin = now;
+		firstTimestampNanos = r.timestampNanos;
+	}
+	busyUntil = now;
+	if (speed > 0) {
+		double offsetNanos = (double) (r.timestampNanos - firstTimestampNanos) / speed;
+		Clock::time_point due = origin + std::chrono::nanoseconds((long long) offsetNanos);
+		if (due > now) busyUntil = due;
+	}
+
+	int distance = (r.rawDistance >= 0) ? r.rawDistance : 0;
+	registers[0x0c] = r.signalStrength;
+	registers[0x0d] = 0x20;
+	registers[0x0e] = r.signalStrength;
+	registers[0x0f] = (unsigned char) ((distance >> 8) & 0xff);
+	registers[0x10] = (unsigned char) (distance & 0xff);
+	// Velocity in counts of the scale the app programmed into 0x68 (see
+	// LidarLite::startVelocity), rounded, so readResult() decodes it back to cm/s
+	int scale = registers[0x68] ? registers[0x68] : LidarLite::VELOCITY_SCALE_0_10_MPS;
+	int scaled = r.velocity * scale;
+	int counts = (scaled >= 0 ? scaled + 1000 : scaled - 1000) / 2000;
+	registers[0x09] = (unsigned char) (signed char) (counts < -128 ? -128 : (counts > 127 ? 127 : counts));
+	// The busy bit is reported from busyUntil instead
+	registers[0x01] = (r.status >= 0) ? (unsigned char) (r.status & ~LidarLite::STATUS_BUSY) : 0;
+	return true;
+}
+
+//--------------------------------------------------------------
+unsigned char LidarLiteReplayBus::registerValue(unsigned char reg) {
+	if (reg == 0x01) {
+		unsigned char stat = registers[0x01];
+		if (Clock::now() < busyUntil) stat |= LidarLite::STATUS_BUSY;
+		return stat;
+	}
+	return registers[reg];
+}
+
+//--------------------------------------------------------------
+int LidarLiteReplayBus::readReg8(unsigned char address, unsigned char reg) {
+	std::lock_guard<std::mutex> guard(mutex);
+	if (address != this->address || finished) return -1;
+	return registerValue(reg & 0x7f);
+}
+
+//--------------------------------------------------------------
+int LidarLiteReplayBus::writeReg8(unsigned char address, unsigned char reg, unsigned char value) {
+	std::lock_guard<std::mutex> guard(mutex);
+	if (address != this->address || finished) return -1;
+	if (reg == 0x00 && (value == 0x03 || value == 0x04)) {
+		if (!loadNext()) return -1;
+	} else if (reg != 0x00) {
+		// Configuration writes are accepted and remembered, a reset (0x00 = 0x00) does nothing
+		registers[reg] = value;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------
+int LidarLiteReplayBus::readBlock(unsigned char address, unsigned char reg, unsigned char * buffer, int length) {
+	std::lock_guard<std::mutex> guard(mutex);
+	if (address != this->address || finished) return -1;
+	bool autoIncrement = (reg & 0x80) != 0;
+	reg &= 0x7f;
+	for (int i = 0; i < length; i++) {
+		buffer[i] = registerValue(reg);
+		if (autoIncrement) reg++;
+	}
+	return 0;
+}
@@ -0,0 +1,75 @@
+/*
+LidarLiteReplayBus - Plays a LidarLiteRecording back as a LIDAR Lite on a virtual I2C bus
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Answers at one address like a LIDAR Lite v2 whose measurements come from a
+recording. Each measure command (0x00 = 0x03/0x04) takes the next record. The
+busy flag stays set until that record's time, relative to the first record,
+divided by speed; speed 0 replays as fast as the host reads. The result
+registers 0x0c-0x10 hold the record's signal strength and raw distance, 0x09
+its velocity in counts of the velocity scale written to 0x68, and the status
+register holds its status bits. Once the recording is exhausted
+every transaction NAKs, so LidarLite reports ERROR_BUS. Free-running mode is
+not replayed.
+
+Example Usage
+------------------------------------------------------------------------------
+	shared_ptr<LidarLiteRecordingReader> recording(new LidarLiteRecordingReader("run.llr"));
+	// Sensor 0 of the recording at twice the original speed
+	myLidarLite.setBus(shared_ptr<LidarLiteI2cBus>(new LidarLiteReplayBus(recording, 0, 2.f)));
+	myLidarLite.begin();
+	while (myLidarLite.measure(m)) { ... }
+*/
+
+#pragma once
+
+#include "LidarLiteI2cBus.hpp"
+#include "LidarLiteRecording.hpp"
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+class LidarLiteReplayBus : public LidarLiteI2cBus
+{
+	public:
+		// sensor selects the records to play, -1 plays every record
+		LidarLiteReplayBus(shared_ptr<LidarLiteRecordingReader> recording, int sensor = -1,
+			float speed = 1.f, unsigned char address = 0x62);
+
+		// Whether a measurement was requested after the last selected record
+		bool isFinished();
+
+		// Records played so far
+		size_t playedCount();
+
+		bool isOpen();
+		int readReg8(unsigned char address, unsigned char reg);
+		int writeReg8(unsigned char address, unsigned char reg, unsigned char value);
+		int readBlock(unsigned char address, unsigned char reg, unsigned char * buffer, int length);
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		shared_ptr<LidarLiteRecordingReader> recording;
+		int sensor;
+		float speed;
+		unsigned char address;
+		std::mutex mutex;
+
+		size_t next;							// Index of the next record to consider
+		size_t played;
+		bool started;							// Whether the first record set the time origin
+		Clock::time_point origin;				// When the first record is replayed
+		unsigned long long firstTimestampNanos;
+		bool finished;
+		Clock::time_point busyUntil;
+		unsigned char registers[256];
+
+		bool loadNext();
+		unsigned char registerValue(unsigned char reg);
+};
@@ -0,0 +1,106 @@
+/*
+LidarLiteRing - Bounded lock-free single-producer/single-consumer ring
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+One thread push()es, one other thread drain()s. Neither ever blocks or takes
+a lock: the producer only writes head, the consumer only writes tail, and
+each publishes with a release store that the other side reads with acquire.
+Storage is allocated once in the constructor.
+
+When the ring is full push() drops the new element and counts an overrun
+rather than overwriting, since overwriting would race with the consumer.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+
+template <typename T>
+class LidarLiteRing
+{
+	public:
+		// capacity is rounded up to a power of two
+		LidarLiteRing(size_t capacity = 1024) {
+			size_t size = 2;
+			while (size < capacity) size <<= 1;
+			buffer.resize(size);
+			mask = size - 1;
+			head.store(0);
+			tail.store(0);
+			overruns.store(0);
+		}
+
+		// Producer side. Returns false (and counts an overrun) if the ring is full.
+		bool push(const T & value) {
+			size_t h = head.load(std::memory_order_relaxed);
+			if (h - tail.load(std::memory_order_acquire) > mask) {
+				overruns.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+			buffer[h & mask] = value;
+			head.store(h + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Consumer side. Copies up to maxCount of the oldest elements into out, returns how many.
+		size_t drain(T * out, size_t maxCount) {
+			size_t t = tail.load(std::memory_order_relaxed);
+			size_t available = head.load(std::memory_order_acquire) - t;
+			size_t n = (available < maxCount) ? available : maxCount;
+			for (size_t i = 0; i < n; i++) {
+				out[i] = buffer[(t + i) & mask];
+			}
+			tail.store(t + n, std::memory_order_release);
+			return n;
+		}
+
+		// Consumer side. Appends every available element to out, returns how many.
+		size_t drain(std::vector<T> & out) {
+			size_t t = tail.load(std::memory_order_relaxed);
+			size_t n = head.load(std::memory_order_acquire) - t;
+			for (size_t i = 0; i < n; i++) {
+				out.push_back(buffer[(t + i) & mask]);
+			}
+			tail.store(t + n, std::memory_order_release);
+			return n;
+		}
+
+		// Number of elements waiting, exact from either side, approximate from elsewhere
+		size_t size() {
+			return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+		}
+
+		size_t capacity() {
+			return mask + 1;
+		}
+
+		// Elements dropped because the ring was full
+		unsigned long overrunCount() {
+			return overruns.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::vector<T> buffer;
+		size_t mask;
+		// head and tail a cache line apart so producer and consumer don't false-share.
+		// Padding rather than alignas(64): an over-aligned type isn't aligned by
+		// new before C++17, and rings are often allocated with new.
+		char pad0[64];
+		std::atomic<size_t> head;
+		char pad1[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<size_t> tail;
+		char pad2[64 - sizeof(std::atomic<size_t>)];
+		std::atomic<unsigned long> overruns;
+		char pad3[64 - sizeof(std::atomic<unsigned long>)];
+
+		// Not copyable
+		LidarLiteRing(const LidarLiteRing &);
+		LidarLiteRing & operator=(const LidarLiteRing &);
+};
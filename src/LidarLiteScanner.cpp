@@ -0,0 +1,252 @@
+/*
+LidarLiteScanner - Pan/tilt sweeps assembled into structure-of-arrays point clouds
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteScanner.hpp"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LIDARLITE_SCANNER_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define LIDARLITE_SCANNER_NEON
+#endif
+
+typedef chrono::steady_clock Clock;
+
+// Number of grid steps from min to max, with some slack for rounding
+static int stepCount(float min, float max, float step) {
+	if (step <= 0 || max <= min) return 1;
+	return (int) std::floor((max - min) / step + 1e-3f) + 1;
+}
+
+// ***************************************************
+// Constructor
+// ***************************************************
+LidarLiteScanner::LidarLiteScanner(LidarLite & lidar, shared_ptr<LidarLiteActuator> actuator) :
+	lidar(lidar), actuator(actuator) {
+	sequence = 0;
+	running = false;
+	setPattern(LidarLiteScanPattern());
+}
+// END Constructor
+// ***************************************************
+
+// ***************************************************
+// Destructor
+// ***************************************************
+LidarLiteScanner::~LidarLiteScanner() {
+	stop();
+}
+// END Destructor
+// ***************************************************
+
+/* =============================================================================
+  setPattern
+  Lays out the grid in scan order, reversing every other row when
+  serpentine, and computes each point's unit direction once:
+  x = cos(tilt) cos(pan), y = cos(tilt) sin(pan), z = sin(tilt).
+============================================================================= */
+void LidarLiteScanner::setPattern(const LidarLiteScanPattern & pattern) {
+	if (running) return;
+	this->pattern = pattern;
+	int columns = stepCount(pattern.panMin, pattern.panMax, pattern.panStep);
+	int rows = stepCount(pattern.tiltMin, pattern.tiltMax, pattern.tiltStep);
+	size_t count = (size_t) columns * rows;
+	pans.resize(count);
+	tilts.resize(count);
+	ux.resize(count);
+	uy.resize(count);
+	uz.resize(count);
+
+	size_t i = 0;
+	for (int row = 0; row < rows; row++) {
+		float tilt = pattern.tiltMin + row * pattern.tiltStep;
+		bool reverse = pattern.serpentine && (row & 1);
+		for (int column = 0; column < columns; column++) {
+			int c = reverse ? columns - 1 - column : column;
+			pans[i] = pattern.panMin + c * pattern.panStep;
+			tilts[i] = tilt;
+			double p = pans[i] * M_PI / 180;
+			double t = tilts[i] * M_PI / 180;
+			ux[i] = (float) (std::cos(t) * std::cos(p));
+			uy[i] = (float) (std::cos(t) * std::sin(p));
+			uz[i] = (float) std::sin(t);
+			i++;
+		}
+	}
+}
+
+const LidarLiteScanPattern & LidarLiteScanner::getPattern() {
+	return pattern;
+}
+
+size_t LidarLiteScanner::pointCount() {
+	return pans.size();
+}
+// END setPattern
+// ***************************************************
+
+/* =============================================================================
+  scan
+  Process
+  ------------------------------------------------------------------------------
+  1.  Move to the first point and wait for the mount to settle
+  2.  Trigger, then wait for the busy flag to clear
+  3.  Command the move to the next point straight away, then read the latched
+      result while the mount moves
+  4.  Wait out the rest of the settling time and repeat from 2
+  5.  Convert the sweep to Cartesian coordinates
+============================================================================= */
+size_t LidarLiteScanner::scan(LidarLiteScanFrame & frame) {
+	size_t count = pans.size();
+	frame.pan.assign(pans.begin(), pans.end());
+	frame.tilt.assign(tilts.begin(), tilts.end());
+	frame.distance.resize(count);
+	frame.signalStrength.resize(count);
+	frame.status.resize(count);
+	frame.timestampNanos.resize(count);
+	frame.x.resize(count);
+	frame.y.resize(count);
+	frame.z.resize(count);
+	frame.sequence = sequence++;
+	frame.validCount = 0;
+	if (count == 0) return 0;
+
+	// Where the mount was left is unknown, allow for a move across the whole pattern
+	actuator->moveTo(pans[0], tilts[0]);
+	Clock::time_point ready = Clock::now() + chrono::microseconds(actuator->settleMicros(
+		pattern.panMax - pattern.panMin, pattern.tiltMax - pattern.tiltMin));
+
+	for (size_t i = 0; i < count; i++) {
+		std::this_thread::sleep_until(ready);
+		bool completed = lidar.trigger() && waitForCompletion();
+		Clock::time_point now = Clock::now();
+		if (i + 1 < count) {
+			actuator->moveTo(pans[i + 1], tilts[i + 1]);
+			ready = now + chrono::microseconds(actuator->settleMicros(pans[i + 1] - pans[i], tilts[i + 1] - tilts[i]));
+		}
+
+		LidarLiteMeasurement m;
+		bool success = completed && lidar.readMeasurement(m);
+		bool valid = success && m.distance > 0 && m.status >= 0 && !(m.status & LidarLite::STATUS_SIGNAL_INVALID);
+		frame.distance[i] = valid ? (float) m.distance : -1;
+		frame.signalStrength[i] = (uint8_t) (success ? m.signalStrength : 0);
+		frame.status[i] = (int16_t) (success ? m.status : -1);
+		frame.timestampNanos[i] = chrono::duration_cast<chrono::nanoseconds>(now.time_since_epoch()).count();
+		if (valid) frame.validCount++;
+	}
+
+	toCartesian(frame.distance.data(), ux.data(), uy.data(), uz.data(),
+		frame.x.data(), frame.y.data(), frame.z.data(), count);
+	return frame.validCount;
+}
+
+//--------------------------------------------------------------
+// Polls from ~80% of the expected acquisition time with a growing
+// back-off, as LidarLiteArray::measureAll() does for each sensor
+bool LidarLiteScanner::waitForCompletion() {
+	Clock::time_point due = lidar.expectedCompletion();
+	int dueMicros = (int) chrono::duration_cast<chrono::microseconds>(due - Clock::now()).count();
+	std::this_thread::sleep_until(due - chrono::microseconds(dueMicros / 5));
+	int backoffMicros = std::max(50, dueMicros / 16);
+	while (true) {
+		int done = lidar.pollCompletion();
+		if (done != 0) return (done == 1);
+		std::this_thread::sleep_for(chrono::microseconds(backoffMicros));
+		backoffMicros = std::min(backoffMicros * 2, 1000);
+	}
+}
+// END scan
+// ***************************************************
+
+// ***************************************************
+// Continuous sweeps on a thread
+// ***************************************************
+void LidarLiteScanner::start(FrameCallback callback) {
+	if (running) return;
+	running = true;
+	thread = std::thread(&LidarLiteScanner::loop, this, callback);
+}
+
+void LidarLiteScanner::stop() {
+	if (!running) return;
+	running = false;
+	if (thread.joinable()) thread.join();
+}
+
+bool LidarLiteScanner::isScanning() {
+	return running;
+}
+
+void LidarLiteScanner::loop(FrameCallback callback) {
+	while (running) {
+		scan(threadFrame);
+		if (callback) callback(threadFrame);
+	}
+}
+// END Continuous sweeps
+// ***************************************************
+
+// ***************************************************
+// Polar to Cartesian
+// ***************************************************
+const char * LidarLiteScanner::kernelName() {
+#if defined(LIDARLITE_SCANNER_SSE2)
+	return "sse2";
+#elif defined(LIDARLITE_SCANNER_NEON)
+	return "neon";
+#else
+	return "scalar";
+#endif
+}
+
+/* =============================================================================
+  toCartesian
+  Four points per step with unaligned loads and stores; the distance > 0
+  comparison selects between the product and NaN without a branch.
+============================================================================= */
+void LidarLiteScanner::toCartesian(const float * distance, const float * ux, const float * uy, const float * uz,
+	float * x, float * y, float * z, size_t count) {
+	const float nan = std::numeric_limits<float>::quiet_NaN();
+	size_t i = 0;
+#if defined(LIDARLITE_SCANNER_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 nans = _mm_set1_ps(nan);
+	for (; i + 4 <= count; i += 4) {
+		__m128 d = _mm_loadu_ps(distance + i);
+		__m128 valid = _mm_cmpgt_ps(d, zero);
+		__m128 invalid = _mm_andnot_ps(valid, nans);
+		_mm_storeu_ps(x + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(d, _mm_loadu_ps(ux + i))), invalid));
+		_mm_storeu_ps(y + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(d, _mm_loadu_ps(uy + i))), invalid));
+		_mm_storeu_ps(z + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(d, _mm_loadu_ps(uz + i))), invalid));
+	}
+#elif defined(LIDARLITE_SCANNER_NEON)
+	const float32x4_t zero = vdupq_n_f32(0);
+	const float32x4_t nans = vdupq_n_f32(nan);
+	for (; i + 4 <= count; i += 4) {
+		float32x4_t d = vld1q_f32(distance + i);
+		uint32x4_t valid = vcgtq_f32(d, zero);
+		vst1q_f32(x + i, vbslq_f32(valid, vmulq_f32(d, vld1q_f32(ux + i)), nans));
+		vst1q_f32(y + i, vbslq_f32(valid, vmulq_f32(d, vld1q_f32(uy + i)), nans));
+		vst1q_f32(z + i, vbslq_f32(valid, vmulq_f32(d, vld1q_f32(uz + i)), nans));
+	}
+#endif
+	for (; i < count; i++) {
+		bool valid = distance[i] > 0;
+		x[i] = valid ? distance[i] * ux[i] : nan;
+		y[i] = valid ? distance[i] * uy[i] : nan;
+		z[i] = valid ? distance[i] * uz[i] : nan;
+	}
+}
+// END Polar to Cartesian
+// ***************************************************
@@ -0,0 +1,120 @@
+/*
+LidarLiteScanner - Pan/tilt sweeps assembled into structure-of-arrays point clouds
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Steps a LidarLiteActuator through a grid of pan/tilt angles and measures at
+each one. A measurement's result is latched once the busy flag clears, so the
+next move is commanded right then and the result is read while the mount is
+already moving; a point costs about one acquisition plus the settling time.
+Rows alternate direction so the mount never swings back across the sweep.
+
+Each sweep fills a LidarLiteScanFrame: one array per field, in scan order,
+tagged with the commanded angles and the time each acquisition completed.
+The grid's direction cosines are computed once per pattern, so converting a
+sweep to Cartesian coordinates is three multiplies per point, done four at a
+time with SSE2 or NEON. Points without a valid return come out as NaN.
+
+Example Usage
+------------------------------------------------------------------------------
+	LidarLiteScanPattern pattern;
+	pattern.panMin = -60; pattern.panMax = 60; pattern.panStep = 2;
+	pattern.tiltMin = -10; pattern.tiltMax = 30; pattern.tiltStep = 2;
+	LidarLiteScanner scanner(myLidarLite, shared_ptr<LidarLiteActuator>(new MyServoMount()));
+	scanner.setPattern(pattern);
+
+	LidarLiteScanFrame frame;
+	scanner.scan(frame);					// One sweep, blocking
+	for (size_t i = 0; i < frame.size(); i++) plot(frame.x[i], frame.y[i], frame.z[i]);
+
+	scanner.start([](const LidarLiteScanFrame & frame) { ... });	// Sweep continuously on a thread
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include "LidarLiteActuator.hpp"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <stdint.h>
+
+struct LidarLiteScanPattern
+{
+	float panMin, panMax, panStep;			// Degrees, positive to the left
+	float tiltMin, tiltMax, tiltStep;		// Degrees, positive up
+	bool serpentine;						// Alternate the pan direction every row (default)
+
+	LidarLiteScanPattern() : panMin(-45), panMax(45), panStep(3), tiltMin(0), tiltMax(0), tiltStep(1), serpentine(true) {}
+};
+
+struct LidarLiteScanFrame
+{
+	// One entry per point, in the order they were measured
+	vector<float> pan;						// Commanded degrees
+	vector<float> tilt;
+	vector<float> distance;					// cm, -1 if the measurement failed or found no signal
+	vector<uint8_t> signalStrength;
+	vector<int16_t> status;					// Status byte, -1 if not read
+	vector<uint64_t> timestampNanos;		// steady_clock time the acquisition completed
+	vector<float> x, y, z;					// cm, x forward, y left, z up; NaN without a valid distance
+
+	unsigned int sequence;					// Counts the sweeps of a scanner
+	size_t validCount;						// Points with a valid distance
+
+	size_t size() const { return distance.size(); }
+};
+
+class LidarLiteScanner
+{
+	public:
+		LidarLiteScanner(LidarLite & lidar, shared_ptr<LidarLiteActuator> actuator);
+		~LidarLiteScanner();
+
+		// Grid to sweep. Not while start()ed.
+		void setPattern(const LidarLiteScanPattern & pattern);
+		const LidarLiteScanPattern & getPattern();
+		size_t pointCount();
+
+		// One full sweep into frame, reusing its storage. Returns the number of valid points.
+		size_t scan(LidarLiteScanFrame & frame);
+
+		// Sweeps back to back on a thread, passing each finished frame to callback on that
+		// thread. The frame is reused for the next sweep, so copy what has to outlive the call.
+		typedef std::function<void(const LidarLiteScanFrame & frame)> FrameCallback;
+		void start(FrameCallback callback);
+		void stop();							// Returns once the sweep in progress is finished
+		bool isScanning();
+
+		// Cartesian coordinates from distances and direction cosines, count entries each. Distances
+		// of 0 or less give NaN. Unaligned arrays are fine.
+		static void toCartesian(const float * distance, const float * ux, const float * uy, const float * uz,
+			float * x, float * y, float * z, size_t count);
+
+		// Which kernel implementation was compiled in: "sse2", "neon" or "scalar"
+		static const char * kernelName();
+
+	private:
+		LidarLite & lidar;
+		shared_ptr<LidarLiteActuator> actuator;
+		LidarLiteScanPattern pattern;
+		vector<float> pans, tilts;				// Grid in scan order
+		vector<float> ux, uy, uz;				// Direction cosines of each grid point
+		unsigned int sequence;
+		std::thread thread;
+		std::atomic<bool> running;
+		LidarLiteScanFrame threadFrame;			// Reused by the scanning thread
+
+		bool waitForCompletion();
+		void loop(FrameCallback callback);
+
+		// Not copyable, owns a thread
+		LidarLiteScanner(const LidarLiteScanner &);
+		LidarLiteScanner & operator=(const LidarLiteScanner &);
+};
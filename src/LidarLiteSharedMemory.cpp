@@ -0,0 +1,261 @@
+/*
+LidarLiteSharedMemory - Sample stream shared with other processes through POSIX shared memory
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteSharedMemory.hpp"
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Segment layout: the header, then capacity slots starting on a cache line.
+// Only fixed-size fields and lock-free atomics, so every process mapping it
+// sees the same thing; magic, version and sampleSize reject other builds.
+struct LidarLiteSharedMemoryHeader
+{
+	std::atomic<uint32_t> magic;			// SEGMENT_MAGIC once the rest of the header is set
+	uint32_t version;
+	uint32_t sampleSize;					// sizeof(LidarLiteSample) of the publisher
+	uint32_t capacity;						// Ring slots, a power of two
+	std::atomic<uint32_t> open;				// 1 while the publisher is attached
+	alignas(64) std::atomic<uint64_t> head;	// Samples published; sample i is in slot i & (capacity - 1)
+	alignas(64) std::atomic<uint32_t> latestSequence;	// Odd while latest is being written
+	LidarLiteSample latest;
+};
+
+struct LidarLiteSharedMemorySlot
+{
+	std::atomic<uint64_t> stamp;			// Index + 1 of the sample in the slot, 0 while it is written
+	LidarLiteSample sample;
+};
+
+static_assert(ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+	"shared memory counters must be lock-free to work across processes");
+
+static const uint32_t SEGMENT_MAGIC = 0x4d534c4c;		// "LLSM" in little-endian memory
+
+static const int LATEST_RETRIES = 10000;
+
+static size_t slotsOffset() {
+	return (sizeof(LidarLiteSharedMemoryHeader) + 63) & ~(size_t) 63;
+}
+
+// ***************************************************
+// LidarLiteSharedMemoryPublisher
+// ***************************************************
+LidarLiteSharedMemoryPublisher::LidarLiteSharedMemoryPublisher(const std::string & name, size_t capacity) :
+	name(name) {
+	header = NULL;
+	slots = NULL;
+	length = 0;
+	size_t size = 2;
+	while (size < capacity) size <<= 1;
+	mask = size - 1;
+
+	// A fresh segment, so readers still holding one left behind by a
+	// previous publisher never see it change under them
+	shm_unlink(name.c_str());
+	int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+	if (fd < 0) return;
+	size_t bytes = slotsOffset() + size * sizeof(LidarLiteSharedMemorySlot);
+	void * mapping = MAP_FAILED;
+	if (ftruncate(fd, (off_t) bytes) == 0) {
+		mapping = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	}
+	::close(fd);
+	if (mapping == MAP_FAILED) {
+		shm_unlink(name.c_str());
+		return;
+	}
+
+	// ftruncate() zero filled the segment, which is a valid state for every field
+	length = bytes;
+	header = (LidarLiteSharedMemoryHeader *) mapping;
+	slots = (LidarLiteSharedMemorySlot *) ((unsigned char *) mapping + slotsOffset());
+	header->version = VERSION;
+	header->sampleSize = sizeof(LidarLiteSample);
+	header->capacity = (uint32_t) size;
+	header->open.store(1, std::memory_order_relaxed);
+	header->magic.store(SEGMENT_MAGIC, std::memory_order_release);
+}
+
+LidarLiteSharedMemoryPublisher::~LidarLiteSharedMemoryPublisher() {
+	close();
+}
+
+bool LidarLiteSharedMemoryPublisher::isOpen() {
+	return (header != NULL);
+}
+
+void LidarLiteSharedMemoryPublisher::close() {
+	if (!header) return;
+	header->open.store(0, std::memory_order_release);
+	munmap(header, length);
+	shm_unlink(name.c_str());
+	header = NULL;
+	slots = NULL;
+}
+
+unsigned long long LidarLiteSharedMemoryPublisher::publishedCount() {
+	return header ? header->head.load(std::memory_order_relaxed) : 0;
+}
+
+const std::string & LidarLiteSharedMemoryPublisher::getName() {
+	return name;
+}
+
+/* =============================================================================
+  publish
+  Both the ring slot and the latest sample are seqlocks: the stamp or
+  sequence is invalidated, the sample written, then the stamp or sequence
+  released. A reader that saw a valid stamp both before and after copying
+  knows it got an intact sample.
+============================================================================= */
+void LidarLiteSharedMemoryPublisher::publish(const LidarLiteSample & sample) {
+	if (!header) return;
+	uint64_t index = header->head.load(std::memory_order_relaxed);
+	LidarLiteSharedMemorySlot & slot = slots[index & mask];
+	slot.stamp.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.sample = sample;
+	slot.stamp.store(index + 1, std::memory_order_release);
+	header->head.store(index + 1, std::memory_order_release);
+
+	uint32_t sequence = header->latestSequence.load(std::memory_order_relaxed);
+	header->latestSequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	header->latest = sample;
+	header->latestSequence.store(sequence + 2, std::memory_order_release);
+}
+// END LidarLiteSharedMemoryPublisher
+// ***************************************************
+
+// ***************************************************
+// LidarLiteSharedMemoryReader
+// ***************************************************
+LidarLiteSharedMemoryReader::LidarLiteSharedMemoryReader(const std::string & name, bool fromOldest) {
+	header = NULL;
+	slots = NULL;
+	length = 0;
+	mask = 0;
+	cursor = 0;
+	lost = 0;
+
+	int fd = shm_open(name.c_str(), O_RDONLY, 0);
+	if (fd < 0) return;
+	struct stat st;
+	void * mapping = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size >= (off_t) slotsOffset()) {
+		mapping = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	}
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (mapping == MAP_FAILED) return;
+
+	const LidarLiteSharedMemoryHeader * h = (const LidarLiteSharedMemoryHeader *) mapping;
+	bool valid = h->magic.load(std::memory_order_acquire) == SEGMENT_MAGIC &&
+		h->version == LidarLiteSharedMemoryPublisher::VERSION && h->sampleSize == sizeof(LidarLiteSample) &&
+		h->capacity >= 2 && (h->capacity & (h->capacity - 1)) == 0 &&
+		slotsOffset() + h->capacity * sizeof(LidarLiteSharedMemorySlot) <= (size_t) st.st_size;
+	if (!valid) {
+		munmap(mapping, (size_t) st.st_size);
+		return;
+	}
+
+	header = h;
+	slots = (const LidarLiteSharedMemorySlot *) ((const unsigned char *) mapping + slotsOffset());
+	length = (size_t) st.st_size;
+	mask = h->capacity - 1;
+	uint64_t head = h->head.load(std::memory_order_acquire);
+	cursor = head;
+	if (fromOldest) cursor = (head > mask + 1) ? head - (mask + 1) : 0;
+}
+
+LidarLiteSharedMemoryReader::~LidarLiteSharedMemoryReader() {
+	if (header) munmap((void *) header, length);
+}
+
+bool LidarLiteSharedMemoryReader::isOpen() {
+	return (header != NULL);
+}
+
+bool LidarLiteSharedMemoryReader::isPublisherOpen() {
+	return header && header->open.load(std::memory_order_acquire) == 1;
+}
+
+size_t LidarLiteSharedMemoryReader::capacity() {
+	return header ? (size_t) (mask + 1) : 0;
+}
+
+unsigned long long LidarLiteSharedMemoryReader::lostCount() {
+	return lost;
+}
+
+size_t LidarLiteSharedMemoryReader::available() {
+	if (!header) return 0;
+	uint64_t waiting = header->head.load(std::memory_order_acquire) - cursor;
+	return (size_t) ((waiting > mask + 1) ? mask + 1 : waiting);
+}
+
+//--------------------------------------------------------------
+// A write takes nanoseconds, so the retries only run out if the
+// publisher died in the middle of one
+bool LidarLiteSharedMemoryReader::latest(LidarLiteSample & sample) {
+	if (!header) return false;
+	for (int tries = 0; tries < LATEST_RETRIES; tries++) {
+		uint32_t before = header->latestSequence.load(std::memory_order_acquire);
+		if (before == 0) return false;
+		if (before & 1) continue;
+		sample = header->latest;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (header->latestSequence.load(std::memory_order_relaxed) == before) return true;
+	}
+	return false;
+}
+
+/* =============================================================================
+  read
+  Samples the publisher has lapped are skipped and counted as lost: those
+  more than a ring behind up front, and any overwritten while being copied,
+  which the slot's stamp shows.
+============================================================================= */
+size_t LidarLiteSharedMemoryReader::read(LidarLiteSample * samples, size_t maxSamples) {
+	if (!header) return 0;
+	uint64_t head = header->head.load(std::memory_order_acquire);
+	if (head - cursor > mask + 1) {
+		lost += head - (mask + 1) - cursor;
+		cursor = head - (mask + 1);
+	}
+	size_t n = 0;
+	while (cursor < head && n < maxSamples) {
+		const LidarLiteSharedMemorySlot & slot = slots[cursor & mask];
+		uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+		if (stamp == cursor + 1) {
+			samples[n] = slot.sample;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.stamp.load(std::memory_order_relaxed) == stamp) n++;
+			else lost++;
+		} else {
+			lost++;
+		}
+		cursor++;
+	}
+	return n;
+}
+
+size_t LidarLiteSharedMemoryReader::read(vector<LidarLiteSample> & samples) {
+	size_t start = samples.size();
+	samples.resize(start + available());
+	size_t n = read(samples.data() + start, samples.size() - start);
+	samples.resize(start + n);
+	return n;
+}
+// END LidarLiteSharedMemoryReader
+// ***************************************************
@@ -0,0 +1,120 @@
+/*
+LidarLiteSharedMemory - Sample stream shared with other processes through POSIX shared memory
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Only one process can own the sensor, but any number of local processes can
+follow its samples. LidarLiteSharedMemoryPublisher creates a shared memory
+segment (/dev/shm/<name>) holding
+	- the latest sample, behind a seqlock
+	- a ring of the last capacity samples, each slot stamped with the index
+	  of the sample in it
+and is fed from the acquisition thread (see LidarLiteReader::setSharedMemory).
+The publisher never waits for readers and doesn't know about them.
+
+LidarLiteSharedMemoryReader maps the segment read-only and keeps its own
+cursor into the ring. Reading takes no lock and no system call, only loads
+from the mapping; a reader that falls more than capacity samples behind
+skips ahead and counts the samples it lost.
+
+Example Usage
+------------------------------------------------------------------------------
+	// Process owning the sensor
+	shared_ptr<LidarLiteSharedMemoryPublisher> shm(new LidarLiteSharedMemoryPublisher("/lidarlite"));
+	myLidarLite.setSharedMemory(shm);
+	myLidarLite.start();
+
+	// Any other process
+	LidarLiteSharedMemoryReader stream("/lidarlite");
+	LidarLiteSample latest;
+	if (stream.latest(latest)) drawDistance(latest.distance);
+	vector<LidarLiteSample> samples;
+	stream.read(samples);		// Everything published since the last read
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+struct LidarLiteSharedMemoryHeader;
+struct LidarLiteSharedMemorySlot;
+
+class LidarLiteSharedMemoryPublisher
+{
+	public:
+		static const int VERSION = 1;
+
+		// Creates the segment, replacing any left behind by a publisher that didn't close.
+		// capacity is rounded up to a power of two.
+		LidarLiteSharedMemoryPublisher(const std::string & name = "/lidarlite", size_t capacity = 4096);
+		~LidarLiteSharedMemoryPublisher();
+
+		bool isOpen();
+
+		// Makes sample the latest and appends it to the ring. One thread at a time.
+		void publish(const LidarLiteSample & sample);
+
+		// Marks the segment closed for readers and removes its name
+		void close();
+
+		unsigned long long publishedCount();
+		const std::string & getName();
+
+	private:
+		std::string name;
+		LidarLiteSharedMemoryHeader * header;
+		LidarLiteSharedMemorySlot * slots;
+		size_t length;
+		uint64_t mask;
+
+		// Not copyable, owns the mapping
+		LidarLiteSharedMemoryPublisher(const LidarLiteSharedMemoryPublisher &);
+		LidarLiteSharedMemoryPublisher & operator=(const LidarLiteSharedMemoryPublisher &);
+};
+
+class LidarLiteSharedMemoryReader
+{
+	public:
+		// Maps the segment. The cursor starts at the next sample published, or at the oldest
+		// sample still in the ring if fromOldest.
+		LidarLiteSharedMemoryReader(const std::string & name = "/lidarlite", bool fromOldest = false);
+		~LidarLiteSharedMemoryReader();
+
+		// Whether the segment was mapped; false if no publisher has created it or it is
+		// from an incompatible build
+		bool isOpen();
+
+		// Whether the publisher is still attached. A restarted publisher creates a new segment,
+		// so reconnect by constructing a new reader once this turns false.
+		bool isPublisherOpen();
+
+		// Copies the latest sample, false if there is none yet (or the publisher died writing it)
+		bool latest(LidarLiteSample & sample);
+
+		// Copies up to maxSamples samples from the cursor on and advances it, returns how many
+		size_t read(LidarLiteSample * samples, size_t maxSamples);
+		size_t read(vector<LidarLiteSample> & samples);		// Appends every sample waiting
+
+		size_t available();						// Samples published since the cursor, at most capacity()
+		size_t capacity();
+		unsigned long long lostCount();			// Samples overwritten before this reader got to them
+
+	private:
+		const LidarLiteSharedMemoryHeader * header;
+		const LidarLiteSharedMemorySlot * slots;
+		size_t length;
+		uint64_t mask;
+		uint64_t cursor;						// Index of the next sample to read
+		unsigned long long lost;
+
+		// Not copyable, owns the mapping
+		LidarLiteSharedMemoryReader(const LidarLiteSharedMemoryReader &);
+		LidarLiteSharedMemoryReader & operator=(const LidarLiteSharedMemoryReader &);
+};
@@ -0,0 +1,81 @@
+/*
+LidarLiteSimulatedActuator - Simulated pan/tilt mount for a LidarLiteSimulator sensor
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteSimulatedActuator.hpp"
+#include <algorithm>
+#include <cmath>
+
+static const float DEGREES_TO_RADIANS = 3.14159265358979f / 180;
+
+//--------------------------------------------------------------
+LidarLiteSimulatedActuator::LidarLiteSimulatedActuator(std::shared_ptr<LidarLiteSimulator> simulator,
+	unsigned char address, Scene scene, float degreesPerSecond, int settleMicros, int signalStrength) :
+	simulator(simulator), address(address), scene(scene) {
+	this->degreesPerSecond = (degreesPerSecond > 0) ? degreesPerSecond : 1;
+	settle = (settleMicros > 0) ? settleMicros : 0;
+	this->signalStrength = signalStrength;
+	pan = 0;
+	tilt = 0;
+	moves = 0;
+}
+
+//--------------------------------------------------------------
+// The target moves as soon as the move is commanded. LidarLiteScanner only
+// commands the next angle once the current measurement has completed, and
+// the simulator latches results when the busy flag clears.
+bool LidarLiteSimulatedActuator::moveTo(float panDegrees, float tiltDegrees) {
+	pan = panDegrees;
+	tilt = tiltDegrees;
+	moves++;
+	int distance = scene ? scene(pan, tilt) : 0;
+	if (distance > 0) simulator->setTarget(address, distance, signalStrength, 1);
+	else simulator->setTarget(address, 0, 0, 0);
+	return true;
+}
+
+int LidarLiteSimulatedActuator::settleMicros(float panDeltaDegrees, float tiltDeltaDegrees) {
+	float delta = std::max(std::fabs(panDeltaDegrees), std::fabs(tiltDeltaDegrees));
+	return (int) (delta / degreesPerSecond * 1e6f) + settle;
+}
+
+float LidarLiteSimulatedActuator::getPan() {
+	return pan;
+}
+
+float LidarLiteSimulatedActuator::getTilt() {
+	return tilt;
+}
+
+unsigned long LidarLiteSimulatedActuator::moveCount() {
+	return moves;
+}
+
+/* =============================================================================
+  roomScene
+  Distance along the beam to the nearest of the six faces of the room,
+  with the sensor at the centre of the floor plan, sensorHeight up.
+============================================================================= */
+LidarLiteSimulatedActuator::Scene LidarLiteSimulatedActuator::roomScene(float width, float depth, float height, float sensorHeight) {
+	return [=](float panDegrees, float tiltDegrees) -> int {
+		float p = panDegrees * DEGREES_TO_RADIANS;
+		float t = tiltDegrees * DEGREES_TO_RADIANS;
+		float dx = std::cos(t) * std::cos(p);		// Forward, along the depth
+		float dy = std::cos(t) * std::sin(p);		// Left, along the width
+		float dz = std::sin(t);
+		float best = 1e9f;
+		if (dx > 1e-6f) best = std::min(best, (depth / 2) / dx);
+		if (dx < -1e-6f) best = std::min(best, (depth / 2) / -dx);
+		if (dy > 1e-6f) best = std::min(best, (width / 2) / dy);
+		if (dy < -1e-6f) best = std::min(best, (width / 2) / -dy);
+		if (dz > 1e-6f) best = std::min(best, (height - sensorHeight) / dz);
+		if (dz < -1e-6f) best = std::min(best, sensorHeight / -dz);
+		return (best < 4000) ? (int) (best + 0.5f) : 0;
+	};
+}
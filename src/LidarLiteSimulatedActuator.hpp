@@ -0,0 +1,61 @@
+/*
+LidarLiteSimulatedActuator - Simulated pan/tilt mount for a LidarLiteSimulator sensor
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Moves at a fixed slew rate plus a settling time, like a hobby servo. Each move
+asks the scene what the sensor would see at the new angles and sets the
+simulated sensor's target to it, so a LidarLiteScanner can sweep a virtual room
+on a machine without the hardware.
+
+Example Usage
+------------------------------------------------------------------------------
+	std::shared_ptr<LidarLiteSimulator> sim(new LidarLiteSimulator());
+	sim->addDevice(0x62);
+	// A 4m x 6m room, 2.5m high, with the sensor in the middle of it at 1m
+	shared_ptr<LidarLiteActuator> mount(new LidarLiteSimulatedActuator(sim, 0x62,
+		LidarLiteSimulatedActuator::roomScene(400, 600, 250, 100)));
+	LidarLiteScanner scanner(myLidarLite, mount);
+*/
+
+#pragma once
+
+#include "LidarLiteActuator.hpp"
+#include "LidarLiteSimulator.hpp"
+#include <functional>
+#include <memory>
+
+class LidarLiteSimulatedActuator : public LidarLiteActuator
+{
+	public:
+		// Distance in cm the sensor sees at the given angles, 0 or less for no return
+		typedef std::function<int(float panDegrees, float tiltDegrees)> Scene;
+
+		LidarLiteSimulatedActuator(std::shared_ptr<LidarLiteSimulator> simulator, unsigned char address, Scene scene,
+			float degreesPerSecond = 400, int settleMicros = 2000, int signalStrength = 120);
+
+		bool moveTo(float panDegrees, float tiltDegrees);
+		int settleMicros(float panDeltaDegrees, float tiltDeltaDegrees);
+
+		float getPan();							// Last commanded angles
+		float getTilt();
+		unsigned long moveCount();
+
+		// A box shaped room of the given size in cm with the sensor at its centre, height above the floor
+		static Scene roomScene(float width, float depth, float height, float sensorHeight);
+
+	private:
+		std::shared_ptr<LidarLiteSimulator> simulator;
+		unsigned char address;
+		Scene scene;
+		float degreesPerSecond;
+		int settle;
+		int signalStrength;
+		float pan;
+		float tilt;
+		unsigned long moves;
+};
@@ -0,0 +1,484 @@
+/*
+LidarLiteSimulator - In-process simulated LIDAR Lite sensors on a virtual I2C bus
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteSimulator.hpp"
+#include "LidarLite.hpp"
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+/* =============================================================================
+  SimulatedModePin
+  Sleeps until the device's next scheduled completion rather than polling, so
+  a waiting acquisition thread behaves like one blocked on a real GPIO edge.
+  Completions that happened while nobody was waiting collapse into one edge.
+============================================================================= */
+class LidarLiteSimulator::SimulatedModePin : public LidarLiteModePin
+{
+	public:
+		SimulatedModePin(LidarLiteSimulator * simulator, unsigned char address) {
+			this->simulator = simulator;
+			std::lock_guard<std::mutex> guard(simulator->mutex);
+			index = simulator->findDeviceIndex(address);
+			seen = (index >= 0) ? simulator->devices[index].completions : 0;
+		}
+
+		int waitForEdge(int timeoutMicros) {
+			Clock::time_point deadline = Clock::now() + std::chrono::microseconds(timeoutMicros);
+			while (true) {
+				Clock::time_point wake = deadline;
+				{
+					std::lock_guard<std::mutex> guard(simulator->mutex);
+					if (index < 0) return -1;
+					Device * device = &simulator->devices[index];
+					Clock::time_point now = Clock::now();
+					simulator->update(*device, now);
+					if (device->completions != seen) {
+						seen = device->completions;
+						return 1;
+					}
+					if (now >= deadline) return 0;
+					if (device->pending && device->busyUntil < wake) wake = device->busyUntil;
+				}
+				std::this_thread::sleep_until(wake);
+			}
+		}
+
+	private:
+		LidarLiteSimulator * simulator;
+		int index;
+		unsigned long seen;
+};
+
+//--------------------------------------------------------------
+LidarLiteSimulator::LidarLiteSimulator() {
+	transactionMicros = 0;
+	byteMicros = 0;
+	transactions = 0;
+}
+
+//--------------------------------------------------------------
+int LidarLiteSimulator::addDevice(unsigned char address, int hardwareVersion, int softwareVersion) {
+	std::lock_guard<std::mutex> guard(mutex);
+	Device device;
+	device.address = address;
+	device.powered = true;
+	device.programmedAddress = -1;
+	device.primaryDisabled = false;
+	device.serialNumber = 0xa500 + (int) devices.size();
+	device.hwVersion = hardwareVersion;
+	device.swVersion = softwareVersion;
+	device.acquisitionMicros = 6000;
+	device.dcCorrectionMicros = 1500;
+	device.resetMicros = 20000;
+	device.targetDistance = 100;
+	device.targetSignal = 100;
+	device.targetNoise = 0;
+	device.targetVelocity = 0;
+	device.noiseDrift = 0;
+	device.driftedNoise = 0;
+	device.targetSetAt = Clock::now();
+	device.echoDistance = 0;
+	device.echoSignal = 0;
+	device.correlationCursor = 0;
+	memset(device.correlation, 0, sizeof(device.correlation));
+	device.rngState = 0x9e3779b9u ^ address;
+	device.completions = 0;
+	reset(device);
+	devices.push_back(device);
+	return (int) devices.size() - 1;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::setPowered(int device, bool powered) {
+	std::lock_guard<std::mutex> guard(mutex);
+	if (device < 0 || device >= (int) devices.size()) return;
+	Device & d = devices[device];
+	if (d.powered == powered) return;
+	d.powered = powered;
+	d.programmedAddress = -1;
+	d.primaryDisabled = false;
+	reset(d);
+	if (powered) {
+		// Booting takes as long as a reset
+		d.resetting = true;
+		d.pending = true;
+		d.acquisitionStart = Clock::now();
+		d.busyUntil = d.acquisitionStart + std::chrono::microseconds(d.resetMicros);
+	}
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::setBusLatency(int transactionMicros, int byteMicros) {
+	std::lock_guard<std::mutex> guard(mutex);
+	this->transactionMicros = transactionMicros;
+	this->byteMicros = byteMicros;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::setAcquisitionTime(unsigned char address, int micros, int dcCorrectionMicros) {
+	std::lock_guard<std::mutex> guard(mutex);
+	Device * device = findDevice(address);
+	if (device == NULL) return;
+	device->acquisitionMicros = micros;
+	device->dcCorrectionMicros = dcCorrectionMicros;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::setTarget(unsigned char address, int distanceCm, int signalStrength, int noiseCm) {
+	std::lock_guard<std::mutex> guard(mutex);
+	Device * device = findDevice(address);
+	if (device == NULL) return;
+	device->targetDistance = distanceCm;
+	device->targetSignal = signalStrength;
+	device->targetNoise = noiseCm;
+	device->targetSetAt = Clock::now();
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::setNoiseDrift(unsigned char address, int countsPerMeasurement) {
+	std::lock_guard<std::mutex> guard(mutex);
+	Device * device = findDevice(address);
+	if (device == NULL) return;
+	device->noiseDrift = countsPerMeasurement;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::setEcho(unsigned char address, int distanceCm, int signalStrength) {
+	std::lock_guard<std::mutex> guard(mutex);
+	Device * device = findDevice(address);
+	if (device == NULL) return;
+	device->echoDistance = distanceCm;
+	device->echoSignal = signalStrength;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::setTargetVelocity(unsigned char address, int cmPerSecond) {
+	std::lock_guard<std::mutex> guard(mutex);
+	Device * device = findDevice(address);
+	if (device == NULL) return;
+	Clock::time_point now = Clock::now();
+	device->targetDistance = distanceAt(*device, now);
+	device->targetSetAt = now;
+	device->targetVelocity = cmPerSecond;
+}
+
+//--------------------------------------------------------------
+unsigned long LidarLiteSimulator::transactionCount() {
+	std::lock_guard<std::mutex> guard(mutex);
+	return transactions;
+}
+
+//--------------------------------------------------------------
+std::shared_ptr<LidarLiteModePin> LidarLiteSimulator::modePin(unsigned char address) {
+	return std::shared_ptr<LidarLiteModePin>(new SimulatedModePin(this, address));
+}
+
+//--------------------------------------------------------------
+bool LidarLiteSimulator::isOpen() {
+	return true;
+}
+
+/* =============================================================================
+  readReg8
+  Register write of the register address followed by a one byte read:
+  address+W, reg, address+R, data on the wire.
+============================================================================= */
+int LidarLiteSimulator::readReg8(unsigned char address, unsigned char reg) {
+	std::lock_guard<std::mutex> guard(mutex);
+	transactions++;
+	chargeLatency(4);
+
+	Device * device = findDevice(address);
+	if (device == NULL) return -1;	// NAK, nobody at that address
+
+	update(*device, Clock::now());
+
+	// LIDAR Lite v1 does not acknowledge while an acquisition is in progress
+	if (device->hwVersion < 21 && isBusy(*device, Clock::now())) return -1;
+
+	return registerValue(*device, reg & 0x7f);
+}
+
+//--------------------------------------------------------------
+int LidarLiteSimulator::readBlock(unsigned char address, unsigned char reg, unsigned char * buffer, int length) {
+	std::lock_guard<std::mutex> guard(mutex);
+	transactions++;
+	chargeLatency(3 + length);
+
+	Device * device = findDevice(address);
+	if (device == NULL || length <= 0) return -1;
+
+	update(*device, Clock::now());
+	if (device->hwVersion < 21 && isBusy(*device, Clock::now())) return -1;
+
+	// Without the auto-increment bit every byte comes from the same register
+	unsigned char r = reg & 0x7f;
+	bool autoIncrement = (reg & 0x80) != 0;
+	for (int i = 0; i < length; i++) {
+		buffer[i] = registerValue(*device, r);
+		// The correlation port streams, it doesn't advance the register address
+		if (autoIncrement && !isCorrelationPort(*device, r)) r = (r + 1) & 0x7f;
+	}
+	return 0;
+}
+
+//--------------------------------------------------------------
+int LidarLiteSimulator::writeReg8(unsigned char address, unsigned char reg, unsigned char value) {
+	std::lock_guard<std::mutex> guard(mutex);
+	transactions++;
+	chargeLatency(3);
+
+	Device * device = findDevice(address);
+	if (device == NULL) return -1;
+
+	Clock::time_point now = Clock::now();
+	update(*device, now);
+	if (device->hwVersion < 21 && isBusy(*device, now)) return -1;
+
+	unsigned char r = reg & 0x7f;
+	if (r == 0x00) {
+		if (value == 0x00) {
+			// Full reset, the device is unavailable until it has rebooted and
+			// then answers on its power-up address again, like the real hardware
+			reset(*device);
+			device->programmedAddress = -1;
+			device->primaryDisabled = false;
+			device->resetting = true;
+			device->pending = true;
+			device->acquisitionStart = now;
+			device->busyUntil = now + std::chrono::microseconds(device->resetMicros);
+		} else if (value == 0x03 || value == 0x04) {
+			// A non-zero outer loop count turns the trigger into a free-running sequence
+			device->freeRunning = (device->registers[0x11] != 0);
+			device->loopsRemaining = device->registers[0x11];
+			startAcquisition(*device, now, value == 0x04);
+		}
+		return 0;
+	}
+
+	// Address reprogramming only takes if 0x18/0x19 hold this device's serial number
+	if (r == 0x1a && device->registers[0x18] == device->registers[0x16] &&
+		device->registers[0x19] == device->registers[0x17]) {
+		device->programmedAddress = value;
+	}
+	if (r == 0x1e && device->programmedAddress >= 0) {
+		device->primaryDisabled = (value & 0x08) != 0;
+	}
+
+	// Clearing the loop count stops a free-running sequence after the current measurement
+	if (r == 0x11 && device->freeRunning) {
+		device->loopsRemaining = value;
+		if (value == 0) device->freeRunning = false;
+	}
+
+	// Entering test mode snapshots the last measurement's correlation record
+	if (r == 0x40 && value == 0x07 && device->registers[0x40] != 0x07) buildCorrelationRecord(*device);
+
+	device->registers[r] = value;
+	return 0;
+}
+
+//--------------------------------------------------------------
+LidarLiteSimulator::Device * LidarLiteSimulator::findDevice(unsigned char address) {
+	int index = findDeviceIndex(address);
+	return (index >= 0) ? &devices[index] : NULL;
+}
+
+//--------------------------------------------------------------
+int LidarLiteSimulator::findDeviceIndex(unsigned char address) {
+	// The first powered device answering on address wins, real bus collisions aren't modeled
+	for (size_t i = 0; i < devices.size(); i++) {
+		Device & d = devices[i];
+		if (!d.powered) continue;
+		if (d.programmedAddress == address) return (int) i;
+		if (d.address == address && !d.primaryDisabled) return (int) i;
+	}
+	return -1;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::reset(Device & device) {
+	memset(device.registers, 0, sizeof(device.registers));
+	device.registers[0x02] = 0x80;	// maximum acquisition count
+	device.registers[0x04] = 0x08;	// acquisition mode
+	device.registers[0x0d] = 0x20;	// max noise
+	device.registers[0x16] = (unsigned char) (device.serialNumber >> 8);
+	device.registers[0x17] = (unsigned char) (device.serialNumber & 0xff);
+	device.registers[0x41] = (unsigned char) device.hwVersion;
+	device.registers[0x4f] = (unsigned char) device.swVersion;
+	device.pending = false;
+	device.resetting = false;
+	device.freeRunning = false;
+	device.loopsRemaining = 0;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::startAcquisition(Device & device, Clock::time_point start, bool dcCorrection) {
+	int micros = device.acquisitionMicros;
+	// configure(1) clears 0x04 to cut the acquisition count to 1/3
+	if ((device.registers[0x04] & 0x08) == 0) micros /= 3;
+	// Velocity mode measures twice, 0x68 * 0.5ms apart
+	if (device.registers[0x04] & 0x80) micros = 2 * micros + device.registers[0x68] * 500;
+	if (dcCorrection) micros += device.dcCorrectionMicros;
+	device.driftedNoise = dcCorrection ? 0 : device.driftedNoise + device.noiseDrift;
+	device.pending = true;
+	device.acquisitionStart = start;
+	device.busyUntil = start + std::chrono::microseconds(micros);
+}
+
+//--------------------------------------------------------------
+bool LidarLiteSimulator::isBusy(Device & device, Clock::time_point now) {
+	return device.pending && now >= device.acquisitionStart && now < device.busyUntil;
+}
+
+/* =============================================================================
+  update
+  Catches the device up to now: latches every measurement that has finished
+  and, in free-running mode, schedules the following ones. Repeats start one
+  measurement period after the previous start, 0x45 * 0.5ms when bit 5 of
+  0x04 is set and 100ms (10Hz) otherwise, or back to back if the acquisition
+  itself takes longer.
+============================================================================= */
+void LidarLiteSimulator::update(Device & device, Clock::time_point now) {
+	while (device.pending && now >= device.busyUntil) {
+		device.pending = false;
+		if (device.resetting) {
+			device.resetting = false;
+			break;
+		}
+		latchMeasurement(device);
+		device.completions++;
+		
+		if (!device.freeRunning) break;
+		if (device.loopsRemaining != 0xff) device.loopsRemaining--;
+		if (device.loopsRemaining <= 0) {
+			device.freeRunning = false;
+			break;
+		}
+		
+		Clock::duration acquisition = device.busyUntil - device.acquisitionStart;
+		Clock::duration period = std::chrono::microseconds(100000);
+		if (device.registers[0x04] & 0x20) period = std::chrono::microseconds(device.registers[0x45] * 500);
+		if (period < acquisition) period = acquisition;
+		
+		device.pending = true;
+		device.acquisitionStart += period;
+		device.busyUntil = device.acquisitionStart + acquisition;
+	}
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::latchMeasurement(Device & device) {
+	// Numerical Recipes LCG, deterministic for a given address
+	device.rngState = device.rngState * 1664525u + 1013904223u;
+	int jitter = 0;
+	if (device.targetNoise > 0) {
+		jitter = (int) ((device.rngState >> 8) % (unsigned int) (2 * device.targetNoise + 1)) - device.targetNoise;
+	}
+
+	int distance = distanceAt(device, device.busyUntil) + jitter;
+	if (distance < 0) distance = 0;
+	if (distance > 0xffff) distance = 0xffff;
+	int signal = device.targetSignal;
+	if (signal < 0) signal = 0;
+	if (signal > 0xff) signal = 0xff;
+
+	device.registers[0x0c] = (unsigned char) signal;						// correlation peak
+	int noise = 0x18 + (int) ((device.rngState >> 4) & 0x0f) + device.driftedNoise;
+	device.registers[0x0d] = (unsigned char) (noise > 0xff ? 0xff : noise);	// max noise
+	device.registers[0x0e] = (unsigned char) signal;
+	device.registers[0x0f] = (unsigned char) (distance >> 8);
+	device.registers[0x10] = (unsigned char) (distance & 0xff);
+
+	if (device.registers[0x04] & 0x80) {
+		Clock::duration pairDelay = std::chrono::microseconds(device.registers[0x68] * 500);
+		int velocity = distanceAt(device, device.busyUntil) - distanceAt(device, device.busyUntil - pairDelay);
+		if (velocity < -128) velocity = -128;
+		if (velocity > 127) velocity = 127;
+		device.registers[0x09] = (unsigned char) (signed char) velocity;
+	}
+}
+
+//--------------------------------------------------------------
+bool LidarLiteSimulator::isCorrelationPort(Device & device, unsigned char reg) {
+	return reg == 0x52 && device.registers[0x40] == 0x07 && device.registers[0x5d] == 0xc0;
+}
+
+/* =============================================================================
+  buildCorrelationRecord
+  Synthesizes the record from the latched result: uniform noise scaled by the
+  max noise register, a triangular lobe at the target's bin scaled by its
+  signal strength, and the echo if one is set. Values are clamped to the
+  sensor's 9 bit signed range.
+============================================================================= */
+void LidarLiteSimulator::buildCorrelationRecord(Device & device) {
+	int noise = device.registers[0x0d] / 4;
+	for (int i = 0; i < 256; i++) {
+		device.rngState = device.rngState * 1664525u + 1013904223u;
+		device.correlation[i] = (short) ((int) ((device.rngState >> 8) % (unsigned int) (2 * noise + 1)) - noise);
+	}
+
+	int distance = (device.registers[0x0f] << 8) | device.registers[0x10];
+	int lobes[2][2] = { { distance, device.registers[0x0e] }, { device.echoDistance, device.echoSignal } };
+	for (int l = 0; l < 2; l++) {
+		if (lobes[l][1] <= 0) continue;
+		int bin = 8 + lobes[l][0] / 4;
+		for (int d = -3; d <= 3; d++) {
+			int i = bin + d;
+			if (i < 0 || i >= 256) continue;
+			device.correlation[i] += (short) (lobes[l][1] * (4 - (d < 0 ? -d : d)) / 4);
+		}
+	}
+
+	for (int i = 0; i < 256; i++) {
+		if (device.correlation[i] < -256) device.correlation[i] = -256;
+		if (device.correlation[i] > 255) device.correlation[i] = 255;
+	}
+	device.correlationCursor = 0;
+}
+
+//--------------------------------------------------------------
+int LidarLiteSimulator::distanceAt(Device & device, Clock::time_point time) {
+	if (device.targetVelocity == 0) return device.targetDistance;
+	double seconds = std::chrono::duration<double>(time - device.targetSetAt).count();
+	return device.targetDistance + (int) std::floor(device.targetVelocity * seconds + 0.5);
+}
+
+//--------------------------------------------------------------
+unsigned char LidarLiteSimulator::statusByte(Device & device) {
+	unsigned char stat = 0;
+	if (isBusy(device, Clock::now())) stat |= LidarLite::STATUS_BUSY;
+	if (device.registers[0x0e] < 10) stat |= LidarLite::STATUS_SIGNAL_INVALID;
+	return stat;
+}
+
+//--------------------------------------------------------------
+unsigned char LidarLiteSimulator::registerValue(Device & device, unsigned char reg) {
+	if (reg == 0x01 || reg == 0x47) return statusByte(device);
+	if (isCorrelationPort(device, reg)) {
+		int entry = device.correlationCursor / 2;
+		bool high = (device.correlationCursor & 1) != 0;
+		device.correlationCursor = (device.correlationCursor + 1) % 512;
+		short value = device.correlation[entry];
+		return high ? (unsigned char) ((value >> 8) & 0xff) : (unsigned char) (value & 0xff);
+	}
+	return device.registers[reg];
+}
+
+//--------------------------------------------------------------
+void LidarLiteSimulator::chargeLatency(int bytes) {
+	int micros = transactionMicros + byteMicros * bytes;
+	if (micros <= 0) return;
+	// Spin rather than sleep, a real bus transaction is far shorter than the
+	// scheduler's sleep granularity
+	Clock::time_point until = Clock::now() + std::chrono::microseconds(micros);
+	while (Clock::now() < until) {}
+}
@@ -0,0 +1,159 @@
+/*
+LidarLiteSimulator - In-process simulated LIDAR Lite sensors on a virtual I2C bus
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Models the parts of the LIDAR Lite v1/v2 register map used by LidarLite:
+	- 0x00 measure/reset command, 0x01 (v2) and 0x47 (v1) status
+	- 0x04 acquisition mode, 0x1c threshold bypass
+	- 0x11 outer loop count and 0x45 measurement delay (free-running mode)
+	- 0x04 = 0xa0 velocity mode, 0x68 velocity scaling and 0x09 velocity
+	- 0x40 test mode, 0x5d memory bank and 0x52 correlation record port
+	- 0x16/0x17 serial number, 0x18-0x1a and 0x1e address reprogramming
+	- 0x0c-0x10 correlation peak, max noise, signal strength and distance
+	- 0x41/0x4f hardware and software version
+Writing 0x03 or 0x04 to 0x00 sets the busy bit for the configured acquisition
+time (1/3 of it when 0x04 is cleared by configure(1)), after which the result
+registers are latched. Setting the high bit of the register address makes
+readBlock() auto-increment through consecutive registers. A non-zero outer
+loop count makes the trigger start a free-running sequence that repeats at
+the 0x45 delay (0.5ms per count, when bit 5 of 0x04 is set) and signals each
+completed measurement on the simulated MODE pin. In velocity mode a trigger
+makes two acquisitions 0x68 * 0.5ms apart and 0x09 holds the target's signed
+movement between them (see setTargetVelocity). With 0x5d = 0xc0 and test mode
+(0x40 = 0x07) on, reads of 0x52 stream a synthetic 256 entry correlation record
+of the last measurement, two bytes per entry: a noise floor from the max noise
+register, the target's peak at bin 8 + distance / 4 and an optional echo
+(see setEcho). Several devices can share
+the default address; power them up one at a time with setPowered() to give
+each a unique address, as with power-enable lines on a real rig. v1 devices NAK
+every read while busy, like the real hardware. Max noise can be made to climb between DC
+corrections (see setNoiseDrift). Measurement noise comes from a fixed-seed generator so runs are
+repeatable, and every transaction can be charged a configurable bus latency
+so the full read path can be timed on a machine without a sensor attached.
+
+Example Usage
+------------------------------------------------------------------------------
+	std::shared_ptr<LidarLiteSimulator> sim(new LidarLiteSimulator());
+	sim->addDevice(0x62);
+	sim->setTarget(0x62, 250, 120, 2);
+	sim->setBusLatency(100, 90);		// ~100kHz I2C
+	myLidarLite.setBus(sim);
+	myLidarLite.begin();
+*/
+
+#pragma once
+
+#include "LidarLiteI2cBus.hpp"
+#include "LidarLiteModePin.hpp"
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class LidarLiteSimulator : public LidarLiteI2cBus
+{
+	public:
+		LidarLiteSimulator();
+
+		// Adds a powered simulated sensor and returns its index. hardwareVersion < 21 models a LIDAR Lite v1.
+		int addDevice(unsigned char address = 0x62, int hardwareVersion = 21, int softwareVersion = 9);
+
+		// Switches a device's power. Powering off forgets a reprogrammed address,
+		// powering on boots the device like a reset.
+		void setPowered(int device, bool powered);
+
+		// Charges every transaction transactionMicros plus byteMicros per byte on the wire
+		void setBusLatency(int transactionMicros, int byteMicros = 0);
+
+		// Acquisition time of the default configuration and the extra time taken by DC correction
+		void setAcquisitionTime(unsigned char address, int micros, int dcCorrectionMicros = 0);
+
+		// Sets what the sensor "sees". noiseCm is the peak deviation added to each reading.
+		void setTarget(unsigned char address, int distanceCm, int signalStrength, int noiseCm = 0);
+
+		// Raises max noise by countsPerMeasurement for every acquisition since the last DC
+		// correction, as an uncorrected preamp drifts. 0 (default) keeps it flat.
+		void setNoiseDrift(unsigned char address, int countsPerMeasurement);
+
+		// Adds a weaker second return, e.g. multipath, to the correlation record. signalStrength 0 removes it.
+		void setEcho(unsigned char address, int distanceCm, int signalStrength);
+
+		// Moves the target away from the sensor at cmPerSecond (negative approaches), starting from where it is now
+		void setTargetVelocity(unsigned char address, int cmPerSecond);
+
+		// Number of I2C transactions served since construction
+		unsigned long transactionCount();
+
+		// MODE pin of the device at address, edges on every completed measurement.
+		// The pin must not outlive the simulator.
+		std::shared_ptr<LidarLiteModePin> modePin(unsigned char address = 0x62);
+
+		bool isOpen();
+		int readReg8(unsigned char address, unsigned char reg);
+		int writeReg8(unsigned char address, unsigned char reg, unsigned char value);
+		int readBlock(unsigned char address, unsigned char reg, unsigned char * buffer, int length);
+
+	private:
+		typedef std::chrono::steady_clock Clock;
+
+		struct Device {
+			unsigned char address;				// Power-up address
+			int serialNumber;					// Unique per device
+			bool powered;
+			int programmedAddress;				// Reprogrammed address, -1 if none
+			bool primaryDisabled;				// No longer answers on the power-up address
+			int hwVersion;
+			int swVersion;
+			unsigned char registers[256];
+			bool pending;						// An acquisition (or reset) is scheduled or in progress
+			bool resetting;						// The pending operation is a reset, nothing to latch
+			Clock::time_point acquisitionStart;
+			Clock::time_point busyUntil;
+			bool freeRunning;
+			int loopsRemaining;					// 0xff repeats forever
+			unsigned long completions;			// Measurements latched, drives the MODE pin
+			int acquisitionMicros;
+			int dcCorrectionMicros;
+			int resetMicros;
+			int targetDistance;
+			int targetSignal;
+			int targetNoise;
+			int targetVelocity;					// cm/s
+			int noiseDrift;						// Max noise added per uncorrected acquisition
+			int driftedNoise;					// Max noise added to the acquisition in progress
+			Clock::time_point targetSetAt;		// When the target was at targetDistance
+			int echoDistance;
+			int echoSignal;
+			short correlation[256];				// Record served on 0x52 in test mode
+			int correlationCursor;				// Next byte of the record to serve
+			unsigned int rngState;
+		};
+
+		std::vector<Device> devices;
+		std::mutex mutex;
+		int transactionMicros;
+		int byteMicros;
+		unsigned long transactions;
+
+		class SimulatedModePin;
+		friend class SimulatedModePin;
+
+		Device * findDevice(unsigned char address);
+		int findDeviceIndex(unsigned char address);
+		void startAcquisition(Device & device, Clock::time_point start, bool dcCorrection);
+		bool isBusy(Device & device, Clock::time_point now);
+		void reset(Device & device);
+		void update(Device & device, Clock::time_point now);
+		void latchMeasurement(Device & device);
+		int distanceAt(Device & device, Clock::time_point time);
+		void buildCorrelationRecord(Device & device);
+		bool isCorrelationPort(Device & device, unsigned char reg);
+		unsigned char statusByte(Device & device);
+		unsigned char registerValue(Device & device, unsigned char reg);
+		void chargeLatency(int bytes);
+};
@@ -0,0 +1,196 @@
+/*
+LidarLiteStats - Per-stage latency histograms and event counters for the read path
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteStats.hpp"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+
+// ***************************************************
+// LidarLiteHistogram
+// ***************************************************
+LidarLiteHistogram::LidarLiteHistogram() {
+	reset();
+}
+
+void LidarLiteHistogram::reset() {
+	for (int i = 0; i < BUCKETS; i++) buckets[i].store(0, std::memory_order_relaxed);
+	total.store(0, std::memory_order_relaxed);
+	sum.store(0, std::memory_order_relaxed);
+	minimum.store(~0ULL, std::memory_order_relaxed);
+	maximum.store(0, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+int LidarLiteHistogram::bucketIndex(unsigned long long nanos) {
+	if (nanos < (unsigned long long) LINEAR_LIMIT) return (int) nanos;
+	int msb = 63 - __builtin_clzll(nanos);
+	int sub = (int) ((nanos >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+	return LINEAR_LIMIT + (msb - SUB_BUCKET_BITS - 1) * SUB_BUCKETS + sub;
+}
+
+unsigned long long LidarLiteHistogram::bucketValue(int index) {
+	if (index < LINEAR_LIMIT) return (unsigned long long) index;
+	int msb = SUB_BUCKET_BITS + 1 + (index - LINEAR_LIMIT) / SUB_BUCKETS;
+	int sub = (index - LINEAR_LIMIT) % SUB_BUCKETS;
+	int shift = msb - SUB_BUCKET_BITS;
+	unsigned long long low = (unsigned long long) (SUB_BUCKETS + sub) << shift;
+	return low + ((1ULL << shift) >> 1);
+}
+
+//--------------------------------------------------------------
+void LidarLiteHistogram::record(unsigned long long nanos) {
+	buckets[bucketIndex(nanos)].fetch_add(1, std::memory_order_relaxed);
+	total.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(nanos, std::memory_order_relaxed);
+	unsigned long long current = minimum.load(std::memory_order_relaxed);
+	while (nanos < current && !minimum.compare_exchange_weak(current, nanos, std::memory_order_relaxed)) {}
+	current = maximum.load(std::memory_order_relaxed);
+	while (nanos > current && !maximum.compare_exchange_weak(current, nanos, std::memory_order_relaxed)) {}
+}
+
+unsigned long long LidarLiteHistogram::count() {
+	return total.load(std::memory_order_relaxed);
+}
+
+unsigned long long LidarLiteHistogram::min() {
+	return count() ? minimum.load(std::memory_order_relaxed) : 0;
+}
+
+unsigned long long LidarLiteHistogram::max() {
+	return maximum.load(std::memory_order_relaxed);
+}
+
+double LidarLiteHistogram::mean() {
+	unsigned long long n = count();
+	return n ? (double) sum.load(std::memory_order_relaxed) / n : 0;
+}
+
+unsigned long long LidarLiteHistogram::percentile(double percent) {
+	unsigned long long n = count();
+	if (n == 0) return 0;
+	unsigned long long rank = (unsigned long long) (percent / 100.0 * n + 0.5);
+	if (rank < 1) rank = 1;
+	unsigned long long seen = 0;
+	for (int i = 0; i < BUCKETS; i++) {
+		seen += buckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			// The bucket midpoint can lie outside what was actually recorded
+			unsigned long long value = bucketValue(i);
+			if (value > max()) value = max();
+			if (value < min()) value = min();
+			return value;
+		}
+	}
+	return max();
+}
+// END LidarLiteHistogram
+// ***************************************************
+
+// ***************************************************
+// LidarLiteStats
+// ***************************************************
+LidarLiteStats::LidarLiteStats() {
+	dumping = false;
+	for (int i = 0; i < COUNTER_COUNT; i++) counters[i].store(0, std::memory_order_relaxed);
+}
+
+LidarLiteStats::~LidarLiteStats() {
+	stopDump();
+}
+
+LidarLiteHistogram & LidarLiteStats::histogram(Stage stage) {
+	return stages[stage];
+}
+
+unsigned long long LidarLiteStats::counter(Counter counter) {
+	return counters[counter].load(std::memory_order_relaxed);
+}
+
+void LidarLiteStats::count(Counter counter, unsigned long long n) {
+	counters[counter].fetch_add(n, std::memory_order_relaxed);
+}
+
+void LidarLiteStats::reset() {
+	for (int i = 0; i < STAGE_COUNT; i++) stages[i].reset();
+	for (int i = 0; i < COUNTER_COUNT; i++) counters[i].store(0, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+const char * LidarLiteStats::stageName(Stage stage) {
+	static const char * names[STAGE_COUNT] = {
+		"measurement", "trigger", "busy wait", "status poll", "register read",
+		"v1 workaround", "schedule wait", "loop iteration", "output lock",
+		"correlation read"
+	};
+	return (stage >= 0 && stage < STAGE_COUNT) ? names[stage] : "?";
+}
+
+const char * LidarLiteStats::counterName(Counter counter) {
+	static const char * names[COUNTER_COUNT] = {
+		"measurements", "status polls", "bailouts", "busy timeouts", "bus errors", "v1 retries"
+	};
+	return (counter >= 0 && counter < COUNTER_COUNT) ? names[counter] : "?";
+}
+
+//--------------------------------------------------------------
+std::string LidarLiteStats::report() {
+	std::ostringstream out;
+	out << std::fixed << std::setprecision(1);
+	out << std::left << std::setw(16) << "stage (us)" << std::right
+		<< std::setw(10) << "count" << std::setw(10) << "mean" << std::setw(10) << "p50"
+		<< std::setw(10) << "p90" << std::setw(10) << "p99" << std::setw(10) << "max" << "\n";
+	for (int i = 0; i < STAGE_COUNT; i++) {
+		LidarLiteHistogram & h = stages[i];
+		if (h.count() == 0) continue;
+		out << std::left << std::setw(16) << stageName((Stage) i) << std::right
+			<< std::setw(10) << h.count()
+			<< std::setw(10) << h.mean() / 1000.0
+			<< std::setw(10) << h.percentile(50) / 1000.0
+			<< std::setw(10) << h.percentile(90) / 1000.0
+			<< std::setw(10) << h.percentile(99) / 1000.0
+			<< std::setw(10) << h.max() / 1000.0 << "\n";
+	}
+	for (int i = 0; i < COUNTER_COUNT; i++) {
+		out << std::left << std::setw(16) << counterName((Counter) i) << std::right
+			<< std::setw(10) << counter((Counter) i) << "\n";
+	}
+	return out.str();
+}
+
+//--------------------------------------------------------------
+void LidarLiteStats::startDump(int intervalMillis, std::function<void(const std::string &)> sink) {
+	stopDump();
+	if (intervalMillis <= 0) return;
+	if (!sink) sink = [](const std::string & text) { std::cout << text << std::flush; };
+	dumping = true;
+	dumpThread = std::thread(&LidarLiteStats::dumpLoop, this, intervalMillis, sink);
+}
+
+void LidarLiteStats::stopDump() {
+	{
+		std::lock_guard<std::mutex> guard(dumpMutex);
+		dumping = false;
+	}
+	dumpWake.notify_all();
+	if (dumpThread.joinable()) dumpThread.join();
+}
+
+void LidarLiteStats::dumpLoop(int intervalMillis, std::function<void(const std::string &)> sink) {
+	std::unique_lock<std::mutex> guard(dumpMutex);
+	while (dumping) {
+		if (dumpWake.wait_for(guard, std::chrono::milliseconds(intervalMillis)) == std::cv_status::no_timeout) continue;
+		guard.unlock();
+		sink(report());
+		guard.lock();
+	}
+}
+// END LidarLiteStats
+// ***************************************************
@@ -0,0 +1,152 @@
+/*
+LidarLiteStats - Per-stage latency histograms and event counters for the read path
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Attach one with LidarLite::setStats() (several LidarLites may share one) to
+find out where the time of a measurement goes. Without stats attached the
+instrumented code does one null pointer test per stage and never reads the
+clock.
+
+Histograms are HDR-style: values below 32ns are counted exactly, above that
+each power of two is split in 16 buckets, so percentiles are within ~6%
+over the whole range from nanoseconds to seconds. Recording is a few relaxed
+atomic increments, safe from any number of threads.
+
+Example Usage
+------------------------------------------------------------------------------
+	shared_ptr<LidarLiteStats> stats(new LidarLiteStats());
+	myLidarLite.setStats(stats);
+	stats->startDump(10000);		// Print a report every 10s
+	...
+	cout << stats->histogram(LidarLiteStats::STAGE_BUSY_WAIT).percentile(99) << " ns" << endl;
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+class LidarLiteHistogram
+{
+	public:
+		LidarLiteHistogram();
+
+		void record(unsigned long long nanos);
+		void reset();
+
+		unsigned long long count();
+		unsigned long long min();				// 0 if empty
+		unsigned long long max();
+		double mean();
+		unsigned long long percentile(double percent);	// e.g. 99 for p99, 0 if empty
+
+	private:
+		static const int SUB_BUCKET_BITS = 4;
+		static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+		static const int LINEAR_LIMIT = SUB_BUCKETS * 2;		// Values below this get a bucket each
+		static const int BUCKETS = LINEAR_LIMIT + (64 - SUB_BUCKET_BITS - 1) * SUB_BUCKETS;
+
+		std::atomic<unsigned long long> buckets[BUCKETS];
+		std::atomic<unsigned long long> total;
+		std::atomic<unsigned long long> sum;
+		std::atomic<unsigned long long> minimum;
+		std::atomic<unsigned long long> maximum;
+
+		static int bucketIndex(unsigned long long nanos);
+		static unsigned long long bucketValue(int index);	// Midpoint of the bucket
+
+		// Not copyable
+		LidarLiteHistogram(const LidarLiteHistogram &);
+		LidarLiteHistogram & operator=(const LidarLiteHistogram &);
+};
+
+class LidarLiteStats
+{
+	public:
+		// Timed stages
+		enum Stage {
+			STAGE_MEASUREMENT = 0,		// A whole distance() or measure() call
+			STAGE_TRIGGER,				// Writing the measure command
+			STAGE_BUSY_WAIT,			// Waiting for the busy flag, including sleeps
+			STAGE_STATUS_POLL,			// One status register read while waiting
+			STAGE_REGISTER_READ,		// Reading result registers once idle
+			STAGE_V1_WORKAROUND,		// v1 settle sleep and NAK retries around a read
+			STAGE_SCHEDULE_WAIT,		// Reader thread waiting for its next measurement
+			STAGE_LOOP_ITERATION,		// One pass of the reader's acquisition loop
+			STAGE_OUTPUT_LOCK,			// Waiting for the reader's output mutex
+			STAGE_CORRELATION_READ,		// Reader capturing and analyzing a correlation record
+			STAGE_COUNT
+		};
+
+		// Counted events
+		enum Counter {
+			COUNTER_MEASUREMENTS = 0,	// Acquisitions triggered
+			COUNTER_STATUS_POLLS,		// Status register reads while waiting for busy
+			COUNTER_BAILOUTS,			// Reads abandoned because the sensor stayed busy or NAKed
+			COUNTER_BUSY_TIMEOUTS,		// Busy flag still set at the busy timeout
+			COUNTER_BUS_ERRORS,			// Failed I2C transactions
+			COUNTER_V1_RETRIES,			// Reads repeated after a v1 NAK
+			COUNTER_COUNT
+		};
+
+		LidarLiteStats();
+		~LidarLiteStats();
+
+		LidarLiteHistogram & histogram(Stage stage);
+		unsigned long long counter(Counter counter);
+		void count(Counter counter, unsigned long long n = 1);
+		void reset();
+
+		// Table of every stage (count, mean, p50, p90, p99, max in microseconds) and counter
+		std::string report();
+
+		// Calls sink with report() every intervalMillis on a background thread, prints to cout by default
+		void startDump(int intervalMillis, std::function<void(const std::string &)> sink = std::function<void(const std::string &)>());
+		void stopDump();
+
+		static const char * stageName(Stage stage);
+		static const char * counterName(Counter counter);
+
+	private:
+		LidarLiteHistogram stages[STAGE_COUNT];
+		std::atomic<unsigned long long> counters[COUNTER_COUNT];
+
+		std::thread dumpThread;
+		std::mutex dumpMutex;
+		std::condition_variable dumpWake;
+		bool dumping;
+
+		void dumpLoop(int intervalMillis, std::function<void(const std::string &)> sink);
+
+		// Not copyable, owns a thread
+		LidarLiteStats(const LidarLiteStats &);
+		LidarLiteStats & operator=(const LidarLiteStats &);
+};
+
+// Records the time from construction to destruction into a stage, if stats is not NULL
+class LidarLiteStageTimer
+{
+	public:
+		LidarLiteStageTimer(LidarLiteStats * stats, LidarLiteStats::Stage stage) : stats(stats), stage(stage) {
+			if (stats) start = std::chrono::steady_clock::now();
+		}
+		~LidarLiteStageTimer() {
+			if (stats) stats->histogram(stage).record((unsigned long long)
+				std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+
+	private:
+		LidarLiteStats * stats;
+		LidarLiteStats::Stage stage;
+		std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,144 @@
+/*
+LidarLiteStatus - Allocation-free status byte decoding and windowed status counters
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteStatus.hpp"
+#include <cstring>
+
+// Descriptions of each status bit, lowest bit first, as statusString() has always printed them
+static const char * const FLAG_NAMES[8] = {
+	"busy", "reference overflow", "signal overflow", "mode select pin",
+	"second peak", "active between pairs", "no signal", "eye safety"
+};
+
+// ***************************************************
+// LidarLiteStatus
+// ***************************************************
+
+/* =============================================================================
+  text
+  The table of every status byte's text is filled once, on first use, like the
+  CRC table in LidarLiteRecording; the longest entry (0xff) is 135 characters.
+============================================================================= */
+const char * LidarLiteStatus::text(int status) {
+	struct Table {
+		char entries[256][144];
+		Table() {
+			static const char HEX[] = "0123456789abcdef";
+			for (int i = 0; i < 256; i++) {
+				char * out = entries[i];
+				memcpy(out, "STATUS BYTE: 0x", 15);
+				out += 15;
+				*out++ = HEX[i >> 4];
+				*out++ = HEX[i & 0x0f];
+				for (int bit = 0; bit < 8; bit++) {
+					if (!(i & (1 << bit))) continue;
+					size_t length = strlen(FLAG_NAMES[bit]);
+					*out++ = ' ';
+					memcpy(out, FLAG_NAMES[bit], length);
+					out += length;
+					*out++ = ';';
+				}
+				*out = '\0';
+			}
+		}
+	};
+	static const Table table;
+
+	if (status == -1) return "STATUS: -1 error;";
+	return table.entries[status & 0xff];
+}
+
+//--------------------------------------------------------------
+const char * LidarLiteStatus::flagName(unsigned char flag) {
+	if (flag == 0 || (flag & (flag - 1)) != 0) return "";
+	return FLAG_NAMES[__builtin_ctz(flag)];
+}
+// END LidarLiteStatus
+// ***************************************************
+
+// ***************************************************
+// LidarLiteStatusMonitor
+// ***************************************************
+LidarLiteStatusMonitor::LidarLiteStatusMonitor(size_t window) {
+	history.resize((window > 0) ? window : 1);
+	reset();
+}
+
+void LidarLiteStatusMonitor::reset() {
+	next = 0;
+	samples.store(0, std::memory_order_relaxed);
+	for (int i = 0; i < 8; i++) flagCounts[i].store(0, std::memory_order_relaxed);
+	failed.store(0, std::memory_order_relaxed);
+	total.store(0, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+// There is one writer, so counters are bumped with plain relaxed
+// loads and stores rather than locked read-modify-writes
+static inline void bump(std::atomic<unsigned long> & counter, bool add) {
+	unsigned long value = counter.load(std::memory_order_relaxed);
+	counter.store(add ? value + 1 : value - 1, std::memory_order_relaxed);
+}
+
+// Adds or removes one sample's flags, walking only the set bits
+void LidarLiteStatusMonitor::apply(int status, bool add) {
+	if (status == -1) {
+		bump(failed, add);
+		return;
+	}
+	unsigned int bits = (unsigned int) status & 0xff;
+	while (bits) {
+		bump(flagCounts[__builtin_ctz(bits)], add);
+		bits &= bits - 1;
+	}
+}
+
+void LidarLiteStatusMonitor::record(int status) {
+	if (status < -1 || status > 0xff) status = -1;
+	unsigned long n = samples.load(std::memory_order_relaxed);
+	if (n == history.size()) {
+		apply(history[next], false);
+	} else {
+		samples.store(n + 1, std::memory_order_relaxed);
+	}
+	history[next] = (short) status;
+	apply(status, true);
+	next = (next + 1 == history.size()) ? 0 : next + 1;
+	total.store(total.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+//--------------------------------------------------------------
+size_t LidarLiteStatusMonitor::window() {
+	return history.size();
+}
+
+unsigned long LidarLiteStatusMonitor::sampleCount() {
+	return samples.load(std::memory_order_relaxed);
+}
+
+unsigned long LidarLiteStatusMonitor::count(unsigned char flag) {
+	if (flag == 0 || (flag & (flag - 1)) != 0) return 0;
+	return flagCounts[__builtin_ctz(flag)].load(std::memory_order_relaxed);
+}
+
+unsigned long LidarLiteStatusMonitor::failedCount() {
+	return failed.load(std::memory_order_relaxed);
+}
+
+double LidarLiteStatusMonitor::fraction(unsigned char flag) {
+	unsigned long n = sampleCount();
+	return n ? (double) count(flag) / n : 0;
+}
+
+unsigned long long LidarLiteStatusMonitor::totalCount() {
+	return total.load(std::memory_order_relaxed);
+}
+// END LidarLiteStatusMonitor
+// ***************************************************
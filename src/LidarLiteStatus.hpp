@@ -0,0 +1,108 @@
+/*
+LidarLiteStatus - Allocation-free status byte decoding and windowed status counters
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+LidarLiteStatus::flags() splits a status byte into named flags and can be
+evaluated at compile time. LidarLiteStatus::text() returns the same text as
+LidarLite::statusString() from a table of all 256 status bytes built once, so
+it never allocates and is cheap enough to call for every sample.
+
+LidarLiteStatusMonitor counts how often each flag was set over the last
+window of samples. Recording a sample only touches the flags that are set in
+it and in the sample leaving the window, so it is close to free while the
+status is clean.
+
+Example Usage
+------------------------------------------------------------------------------
+	LidarLiteStatusFlags f = LidarLiteStatus::flags(myLidarLite.status());
+	if (f.signalInvalid) ...
+	drawText(LidarLiteStatus::text(sample.status));
+
+	shared_ptr<LidarLiteStatusMonitor> monitor(new LidarLiteStatusMonitor(500));
+	myLidarLite.setStatusMonitor(monitor);
+	...
+	cout << monitor->fraction(LidarLite::STATUS_SIGNAL_INVALID) * 100 << "% invalid" << endl;
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include <atomic>
+#include <vector>
+
+struct LidarLiteStatusFlags
+{
+	bool read;					// false if the status couldn't be read (-1), all other flags are false then
+	bool busy;
+	bool referenceOverflow;
+	bool signalOverflow;
+	bool modePin;
+	bool secondPeak;
+	bool betweenPairs;			// Active between velocity measurement pairs
+	bool signalInvalid;
+	bool eyeSafety;
+};
+
+class LidarLiteStatus
+{
+	public:
+		static constexpr LidarLiteStatusFlags flags(int status) {
+			return (status == -1) ? LidarLiteStatusFlags { false, false, false, false, false, false, false, false, false } :
+				LidarLiteStatusFlags {
+					true,
+					(status & LidarLite::STATUS_BUSY) != 0,
+					(status & LidarLite::STATUS_REFERENCE_OVERFLOW) != 0,
+					(status & LidarLite::STATUS_SIGNAL_OVERFLOW) != 0,
+					(status & LidarLite::STATUS_PIN) != 0,
+					(status & LidarLite::STATUS_SECOND_PEAK) != 0,
+					(status & LidarLite::STATUS_TIMESTAMP) != 0,
+					(status & LidarLite::STATUS_SIGNAL_INVALID) != 0,
+					(status & LidarLite::STATUS_EYE_SAFETY_ON) != 0
+				};
+		}
+
+		// Human readable description, e.g. "STATUS BYTE: 0x41 busy; no signal;". Static storage, never NULL.
+		static const char * text(int status);
+
+		// Name of a single STATUS_ bit, e.g. "no signal", or "" if flag isn't exactly one bit
+		static const char * flagName(unsigned char flag);
+};
+
+class LidarLiteStatusMonitor
+{
+	public:
+		LidarLiteStatusMonitor(size_t window = 1000);
+
+		// Adds a status byte, -1 for a failed read. One writer thread at a time.
+		void record(int status);
+
+		// Reads are safe from any thread while another records; the values may be a sample apart.
+		size_t window();
+		unsigned long sampleCount();					// Samples in the window
+		unsigned long count(unsigned char flag);		// Samples in the window with the STATUS_ bit flag set
+		unsigned long failedCount();					// Samples in the window that couldn't be read
+		double fraction(unsigned char flag);			// count(flag) / sampleCount(), 0 if empty
+		unsigned long long totalCount();				// Samples recorded since construction or reset()
+
+		// Not safe while record() is running
+		void reset();
+
+	private:
+		std::vector<short> history;						// Ring of the last window status values
+		size_t next;									// Slot the next sample goes in
+		std::atomic<unsigned long> samples;
+		std::atomic<unsigned long> flagCounts[8];		// Per status bit
+		std::atomic<unsigned long> failed;
+		std::atomic<unsigned long long> total;
+
+		void apply(int status, bool add);
+
+		// Not copyable
+		LidarLiteStatusMonitor(const LidarLiteStatusMonitor &);
+		LidarLiteStatusMonitor & operator=(const LidarLiteStatusMonitor &);
+};
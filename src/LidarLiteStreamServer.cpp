@@ -0,0 +1,521 @@
+/*
+LidarLiteStreamServer - Streams samples to local subscribers over Unix-domain or TCP sockets
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteStreamServer.hpp"
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+static_assert(sizeof(LidarLiteStreamFrameHeader) == 16, "LidarLiteStreamFrameHeader layout");
+
+static const char FRAME_MAGIC[4] = { 'L', 'L', 'S', 'F' };
+static const uint32_t MAX_FRAME_RECORDS = 1 << 20;		// Anything larger is a corrupt stream
+
+// ***************************************************
+// Constructor
+// ***************************************************
+LidarLiteStreamServer::LidarLiteStreamServer(size_t batchSize, int maxLatencyMillis, size_t queueCapacity) :
+	ring(queueCapacity) {
+	this->batchSize = (batchSize > 0) ? batchSize : 1;
+	this->maxLatencyMillis = (maxLatencyMillis > 0) ? maxLatencyMillis : 0;
+	maxQueuedFrames = 64;
+	wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	wakePending = false;
+	idle = false;
+	pendingCount = 0;
+	unixFd = -1;
+	tcpFd = -1;
+	tcpPort = -1;
+	running = false;
+	nextClientId = 0;
+	sent = 0;
+	dropped = 0;
+	pending.reserve(this->batchSize);
+}
+// END Constructor
+// ***************************************************
+
+// ***************************************************
+// Destructor
+// ***************************************************
+LidarLiteStreamServer::~LidarLiteStreamServer() {
+	stop();
+	if (unixFd > -1) {
+		::close(unixFd);
+		unlink(unixPath.c_str());
+	}
+	if (tcpFd > -1) ::close(tcpFd);
+	if (wakeFd > -1) ::close(wakeFd);
+}
+// END Destructor
+// ***************************************************
+
+// ***************************************************
+// Listening sockets
+// ***************************************************
+bool LidarLiteStreamServer::listenUnix(const std::string & path) {
+	if (running || unixFd > -1) return false;
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path.c_str(), path.size());
+
+	// A socket file left by a server that didn't shut down would make bind() fail
+	struct stat st;
+	if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path.c_str());
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) return false;
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+		::close(fd);
+		return false;
+	}
+	unixFd = fd;
+	unixPath = path;
+	return true;
+}
+
+bool LidarLiteStreamServer::listenTcp(int port, bool loopbackOnly) {
+	if (running || tcpFd > -1) return false;
+	int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (fd < 0) return false;
+	int one = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons((uint16_t) port);
+	addr.sin_addr.s_addr = htonl(loopbackOnly ? INADDR_LOOPBACK : INADDR_ANY);
+	socklen_t length = sizeof(addr);
+	if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || ::listen(fd, 16) != 0 ||
+		getsockname(fd, (struct sockaddr *) &addr, &length) != 0) {
+		::close(fd);
+		return false;
+	}
+	tcpFd = fd;
+	tcpPort = ntohs(addr.sin_port);
+	return true;
+}
+
+int LidarLiteStreamServer::getTcpPort() {
+	return tcpPort;
+}
+
+void LidarLiteStreamServer::setMaxQueuedFrames(size_t frames) {
+	if (running) return;
+	maxQueuedFrames = (frames > 0) ? frames : 1;
+}
+// END Listening sockets
+// ***************************************************
+
+// ***************************************************
+// Starts the server thread
+// ***************************************************
+bool LidarLiteStreamServer::start() {
+	if (running) return true;
+	if (wakeFd < 0 || (unixFd < 0 && tcpFd < 0)) return false;
+	running = true;
+	thread = std::thread(&LidarLiteStreamServer::loop, this);
+	return true;
+}
+
+void LidarLiteStreamServer::stop() {
+	if (!running) return;
+	running = false;
+	uint64_t one = 1;
+	if (write(wakeFd, &one, sizeof(one)) < 0) {}
+	if (thread.joinable()) thread.join();
+}
+
+bool LidarLiteStreamServer::isRunning() {
+	return running;
+}
+// END start/stop
+// ***************************************************
+
+/* =============================================================================
+  publish
+  Costs a ring push and, once per batch or when the server thread is asleep
+  with nothing pending, one eventfd write. The full fence pairs with the one
+  in loop(): either the server sees the record before it sleeps, or we see
+  the state it went to sleep in and wake it if needed.
+============================================================================= */
+bool LidarLiteStreamServer::publish(const LidarLiteSample & sample, int sensor) {
+	if (!running) return false;
+	LidarLiteRecord record;
+	LidarLiteRecorder::makeRecord(sample, sensor, record);
+	if (!ring.push(record)) return false;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (idle.load(std::memory_order_relaxed) ||
+		ring.size() + pendingCount.load(std::memory_order_relaxed) >= batchSize) wake();
+	return true;
+}
+
+void LidarLiteStreamServer::wake() {
+	if (wakePending.exchange(true)) return;
+	uint64_t one = 1;
+	if (write(wakeFd, &one, sizeof(one)) < 0) {}
+}
+// END publish
+// ***************************************************
+
+/* =============================================================================
+  loop
+  Process
+  ------------------------------------------------------------------------------
+  1.  Sleep in poll() until a batch fills, the oldest pending record is due,
+      a subscriber's socket takes more data or a client connects
+  2.  Send queued frames to subscribers whose sockets are writable and close
+      subscribers that hung up
+  3.  Accept new subscribers
+  4.  Frame the records published meanwhile: every full batch, then the
+      remainder if the oldest has waited maxLatencyMillis
+  On stop, whatever is pending is framed and sent as far as the sockets take
+  it without blocking, then every subscriber is closed.
+============================================================================= */
+void LidarLiteStreamServer::loop() {
+	typedef chrono::steady_clock Clock;
+	vector<struct pollfd> fds;
+
+	while (running) {
+		int timeout = -1;
+		if (!pending.empty()) {
+			Clock::time_point due = pendingSince + chrono::milliseconds(maxLatencyMillis);
+			long long millis = chrono::duration_cast<chrono::milliseconds>(due - Clock::now()).count() + 1;
+			timeout = (millis > 0) ? (int) millis : 0;
+		}
+
+		fds.clear();
+		struct pollfd p;
+		p.fd = wakeFd;
+		p.events = POLLIN;
+		p.revents = 0;
+		fds.push_back(p);
+		p.fd = unixFd;
+		fds.push_back(p);
+		p.fd = tcpFd;
+		fds.push_back(p);
+		{
+			std::lock_guard<std::mutex> guard(clientsMutex);
+			for (size_t i = 0; i < clients.size(); i++) {
+				p.fd = clients[i].fd;
+				p.events = POLLIN | (clients[i].queue.empty() ? 0 : POLLOUT);
+				fds.push_back(p);
+			}
+		}
+
+		// Don't sleep past a batch or first record the producer saw no need to signal
+		pendingCount.store(pending.size(), std::memory_order_relaxed);
+		idle.store(pending.empty(), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		size_t queued = ring.size();
+		if ((pending.empty() && queued > 0) || pending.size() + queued >= batchSize) timeout = 0;
+		// Negative descriptors are ignored by poll()
+		poll(fds.data(), fds.size(), timeout);
+		idle.store(false, std::memory_order_relaxed);
+
+		if (fds[0].revents & POLLIN) {
+			uint64_t count;
+			if (read(wakeFd, &count, sizeof(count)) < 0) {}
+		}
+		wakePending.store(false, std::memory_order_relaxed);
+
+		std::lock_guard<std::mutex> guard(clientsMutex);
+		// Backwards so closing a subscriber doesn't shift the ones still to check
+		for (size_t i = clients.size(); i-- > 0; ) {
+			short revents = fds[3 + i].revents;
+			bool closed = (revents & (POLLERR | POLLNVAL)) != 0;
+			if (!closed && (revents & (POLLIN | POLLHUP))) {
+				// Subscribers have nothing to say; read until EOF or empty
+				char scratch[256];
+				while (true) {
+					ssize_t n = recv(clients[i].fd, scratch, sizeof(scratch), MSG_DONTWAIT);
+					if (n > 0) continue;
+					if (n < 0 && errno == EINTR) continue;
+					closed = (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK));
+					break;
+				}
+			}
+			if (!closed && (revents & POLLOUT)) closed = !flush(clients[i]);
+			if (closed) closeClient(i);
+		}
+		if (fds[1].revents & POLLIN) accept(unixFd, false);
+		if (fds[2].revents & POLLIN) accept(tcpFd, true);
+
+		if (pending.empty()) pendingSince = Clock::now();
+		ring.drain(pending);
+		while (pending.size() >= batchSize) emit(batchSize);
+		if (!pending.empty() && Clock::now() >= pendingSince + chrono::milliseconds(maxLatencyMillis)) {
+			emit(pending.size());
+		}
+	}
+
+	std::lock_guard<std::mutex> guard(clientsMutex);
+	ring.drain(pending);
+	while (!pending.empty()) emit(std::min(pending.size(), batchSize));
+	for (size_t i = clients.size(); i-- > 0; ) {
+		flush(clients[i]);
+		closeClient(i);
+	}
+}
+
+//--------------------------------------------------------------
+void LidarLiteStreamServer::accept(int listenFd, bool tcp) {
+	while (true) {
+		struct sockaddr_storage addr;
+		socklen_t length = sizeof(addr);
+		int fd = accept4(listenFd, (struct sockaddr *) &addr, &length, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0) {
+			if (errno == EINTR) continue;
+			return;
+		}
+		Client client;
+		client.fd = fd;
+		client.nextSequence = 0;
+		client.dropped = 0;
+		client.stats.id = nextClientId++;
+		client.stats.framesSent = 0;
+		client.stats.framesDropped = 0;
+		client.stats.recordsDropped = 0;
+		client.stats.queuedFrames = 0;
+		if (tcp) {
+			int one = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			const struct sockaddr_in * in = (const struct sockaddr_in *) &addr;
+			char host[INET_ADDRSTRLEN] = "";
+			inet_ntop(AF_INET, &in->sin_addr, host, sizeof(host));
+			char peer[INET_ADDRSTRLEN + 8];
+			snprintf(peer, sizeof(peer), "%s:%d", host, (int) ntohs(in->sin_port));
+			client.stats.peer = peer;
+		} else {
+			client.stats.peer = unixPath;
+		}
+		clients.push_back(client);
+	}
+}
+
+void LidarLiteStreamServer::closeClient(size_t index) {
+	::close(clients[index].fd);
+	clients.erase(clients.begin() + index);
+}
+
+/* =============================================================================
+  emit
+  Frames the oldest count pending records once and queues the frame to every
+  subscriber with room for it. A subscriber without room has the frame
+  dropped; its next frame reports how many records that was.
+============================================================================= */
+void LidarLiteStreamServer::emit(size_t count) {
+	shared_ptr< vector<LidarLiteRecord> > records(
+		new vector<LidarLiteRecord>(pending.begin(), pending.begin() + count));
+	pending.erase(pending.begin(), pending.begin() + count);
+	pendingSince = chrono::steady_clock::now();
+
+	for (size_t i = 0; i < clients.size(); i++) {
+		Client & client = clients[i];
+		if (client.queue.size() >= maxQueuedFrames) {
+			client.dropped += (uint32_t) count;
+			client.stats.framesDropped++;
+			client.stats.recordsDropped += count;
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			continue;
+		}
+		Frame frame;
+		memcpy(frame.header.magic, FRAME_MAGIC, 4);
+		frame.header.recordCount = (uint32_t) count;
+		frame.header.frameSequence = client.nextSequence++;
+		frame.header.droppedRecords = client.dropped;
+		frame.records = records;
+		frame.offset = 0;
+		client.dropped = 0;
+		client.queue.push_back(frame);
+		// Write straight away if nothing was waiting; a failed socket shows up in the next poll()
+		if (client.queue.size() == 1 && !flush(client)) shutdown(client.fd, SHUT_RDWR);
+	}
+}
+
+//--------------------------------------------------------------
+// Sends queued frames until the socket would block. Returns false
+// if the subscriber is gone.
+bool LidarLiteStreamServer::flush(Client & client) {
+	while (!client.queue.empty()) {
+		Frame & frame = client.queue.front();
+		const size_t headerBytes = sizeof(LidarLiteStreamFrameHeader);
+		size_t recordBytes = frame.records->size() * sizeof(LidarLiteRecord);
+		struct iovec iov[2];
+		int count = 0;
+		if (frame.offset < headerBytes) {
+			iov[count].iov_base = (char *) &frame.header + frame.offset;
+			iov[count].iov_len = headerBytes - frame.offset;
+			count++;
+		}
+		size_t recordOffset = (frame.offset > headerBytes) ? frame.offset - headerBytes : 0;
+		iov[count].iov_base = (char *) frame.records->data() + recordOffset;
+		iov[count].iov_len = recordBytes - recordOffset;
+		count++;
+
+		struct msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = iov;
+		msg.msg_iovlen = count;
+		ssize_t n = sendmsg(client.fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+		if (n < 0) {
+			if (errno == EINTR) continue;
+			return (errno == EAGAIN || errno == EWOULDBLOCK);
+		}
+		frame.offset += (size_t) n;
+		if (frame.offset < headerBytes + recordBytes) return true;
+		client.queue.pop_front();
+		client.stats.framesSent++;
+		sent.fetch_add(1, std::memory_order_relaxed);
+	}
+	return true;
+}
+// END loop
+// ***************************************************
+
+// ***************************************************
+// Statistics
+// ***************************************************
+vector<LidarLiteStreamServer::Subscriber> LidarLiteStreamServer::subscribers() {
+	std::lock_guard<std::mutex> guard(clientsMutex);
+	vector<Subscriber> result;
+	result.reserve(clients.size());
+	for (size_t i = 0; i < clients.size(); i++) {
+		result.push_back(clients[i].stats);
+		result.back().queuedFrames = clients[i].queue.size();
+	}
+	return result;
+}
+
+int LidarLiteStreamServer::subscriberCount() {
+	std::lock_guard<std::mutex> guard(clientsMutex);
+	return (int) clients.size();
+}
+
+unsigned long long LidarLiteStreamServer::framesSent() {
+	return sent.load(std::memory_order_relaxed);
+}
+
+unsigned long long LidarLiteStreamServer::framesDropped() {
+	return dropped.load(std::memory_order_relaxed);
+}
+
+unsigned long LidarLiteStreamServer::overrunCount() {
+	return ring.overrunCount();
+}
+// END Statistics
+// ***************************************************
+
+// ***************************************************
+// LidarLiteStreamClient
+// ***************************************************
+LidarLiteStreamClient::LidarLiteStreamClient() {
+	fd = -1;
+	dropped = 0;
+}
+
+LidarLiteStreamClient::~LidarLiteStreamClient() {
+	close();
+}
+
+bool LidarLiteStreamClient::connectUnix(const std::string & path) {
+	close();
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	if (path.empty() || path.size() >= sizeof(addr.sun_path)) return false;
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path.c_str(), path.size());
+	fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0) return false;
+	if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) close();
+	return isConnected();
+}
+
+bool LidarLiteStreamClient::connectTcp(const std::string & host, int port) {
+	close();
+	struct addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	char service[16];
+	snprintf(service, sizeof(service), "%d", port);
+	struct addrinfo * addresses = NULL;
+	if (getaddrinfo(host.c_str(), service, &hints, &addresses) != 0) return false;
+	for (struct addrinfo * a = addresses; a != NULL && fd < 0; a = a->ai_next) {
+		fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if (fd > -1 && connect(fd, a->ai_addr, a->ai_addrlen) != 0) close();
+	}
+	freeaddrinfo(addresses);
+	return isConnected();
+}
+
+bool LidarLiteStreamClient::isConnected() {
+	return (fd > -1);
+}
+
+void LidarLiteStreamClient::close() {
+	if (fd > -1) ::close(fd);
+	fd = -1;
+}
+
+int LidarLiteStreamClient::getFd() {
+	return fd;
+}
+
+unsigned long long LidarLiteStreamClient::droppedRecords() {
+	return dropped;
+}
+
+//--------------------------------------------------------------
+bool LidarLiteStreamClient::readFrame(vector<LidarLiteRecord> & records, LidarLiteStreamFrameHeader * header) {
+	LidarLiteStreamFrameHeader h;
+	if (!readFully(&h, sizeof(h))) return false;
+	if (memcmp(h.magic, FRAME_MAGIC, 4) != 0 || h.recordCount > MAX_FRAME_RECORDS) {
+		close();
+		return false;
+	}
+	records.resize(h.recordCount);
+	if (!readFully(records.data(), h.recordCount * sizeof(LidarLiteRecord))) return false;
+	dropped += h.droppedRecords;
+	if (header) *header = h;
+	return true;
+}
+
+bool LidarLiteStreamClient::readFully(void * buffer, size_t length) {
+	char * out = (char *) buffer;
+	while (length > 0 && fd > -1) {
+		ssize_t n = recv(fd, out, length, 0);
+		if (n < 0 && errno == EINTR) continue;
+		if (n <= 0) {
+			close();
+			return false;
+		}
+		out += n;
+		length -= (size_t) n;
+	}
+	return (fd > -1);
+}
+// END LidarLiteStreamClient
+// ***************************************************
@@ -0,0 +1,181 @@
+/*
+LidarLiteStreamServer - Streams samples to local subscribers over Unix-domain or TCP sockets
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+The acquisition thread hands each sample to publish(), which packs it into a
+LidarLiteRecord and pushes it onto a lock-free ring; it never touches a
+socket. The server's own thread collects records into frames of batchSize
+records, or fewer once the oldest has waited maxLatencyMillis, and queues
+each frame to every subscriber.
+
+Every subscriber has its own queue of at most maxQueuedFrames frames, written
+with non-blocking sends as the socket accepts them. When a slow subscriber's
+queue is full, new frames are dropped for that subscriber only and counted;
+the next frame it does get says how many records it missed.
+
+Wire format, host byte order (little-endian on the Raspberry Pi), repeated:
+	LidarLiteStreamFrameHeader								16 bytes
+	LidarLiteRecord[recordCount]							32 bytes each, see LidarLiteRecording.hpp
+LidarLiteStreamClient reads it.
+
+Example Usage
+------------------------------------------------------------------------------
+	shared_ptr<LidarLiteStreamServer> server(new LidarLiteStreamServer(64, 20));
+	server->listenUnix("/tmp/lidarlite.sock");
+	server->listenTcp(5005);				// 127.0.0.1 only
+	server->start();
+	myLidarLite.setStreamServer(server);
+	myLidarLite.start();
+
+	// Another process
+	LidarLiteStreamClient client;
+	client.connectUnix("/tmp/lidarlite.sock");
+	vector<LidarLiteRecord> records;
+	while (client.readFrame(records)) {
+		...
+	}
+*/
+
+#pragma once
+
+#include "LidarLite.hpp"
+#include "LidarLiteRecording.hpp"
+#include "LidarLiteRing.hpp"
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+
+struct LidarLiteStreamFrameHeader
+{
+	char magic[4];						// "LLSF"
+	uint32_t recordCount;				// Records following this header
+	uint32_t frameSequence;				// Counts the frames sent to this subscriber
+	uint32_t droppedRecords;			// Records this subscriber missed since its previous frame
+};
+
+class LidarLiteStreamServer
+{
+	public:
+		// Frames hold up to batchSize records and wait at most maxLatencyMillis for more.
+		// queueCapacity bounds the records waiting for the server thread, see overrunCount().
+		LidarLiteStreamServer(size_t batchSize = 64, int maxLatencyMillis = 20, size_t queueCapacity = 4096);
+		~LidarLiteStreamServer();
+
+		// Listening sockets, set up before start() and kept until destruction. Returns false on failure.
+		bool listenUnix(const std::string & path);				// Replaces a stale socket file at path
+		bool listenTcp(int port, bool loopbackOnly = true);		// port 0 picks a free port, see getTcpPort()
+		int getTcpPort();
+
+		// Frames queued per subscriber before frames are dropped for it. Call before start().
+		void setMaxQueuedFrames(size_t frames);
+
+		bool start();							// Start the server thread, false if nothing is listening
+		void stop();							// Send what is pending if the sockets take it, then close every subscriber
+		bool isRunning();
+
+		// Never blocks. One thread at a time, normally the acquisition thread (see
+		// LidarLiteReader::setStreamServer). Returns false if the ring was full.
+		bool publish(const LidarLiteSample & sample, int sensor = 0);
+
+		struct Subscriber {
+			int id;
+			std::string peer;					// Socket path or address:port
+			unsigned long long framesSent;
+			unsigned long long framesDropped;	// Frames not queued because the subscriber's queue was full
+			unsigned long long recordsDropped;
+			size_t queuedFrames;
+		};
+		vector<Subscriber> subscribers();		// Snapshot of the connected subscribers
+		int subscriberCount();
+
+		unsigned long long framesSent();		// Totals over every subscriber, past and present
+		unsigned long long framesDropped();
+		unsigned long overrunCount();			// Samples publish() dropped because the server thread fell behind
+
+	private:
+		struct Frame {
+			LidarLiteStreamFrameHeader header;
+			shared_ptr< vector<LidarLiteRecord> > records;	// Shared by every subscriber it is queued to
+			size_t offset;						// Bytes of header and records already sent
+		};
+
+		struct Client {
+			int fd;
+			Subscriber stats;
+			uint32_t nextSequence;
+			uint32_t dropped;					// Records dropped since the last queued frame
+			std::deque<Frame> queue;
+		};
+
+		size_t batchSize;
+		int maxLatencyMillis;
+		size_t maxQueuedFrames;
+		LidarLiteRing<LidarLiteRecord> ring;	// publish() to the server thread
+		int wakeFd;								// eventfd the producer signals
+		std::atomic<bool> wakePending;			// Whether wakeFd was signalled since the server last drained
+		std::atomic<bool> idle;					// Server is asleep with nothing pending
+		std::atomic<size_t> pendingCount;		// pending.size() when the server last went to sleep
+		int unixFd;
+		std::string unixPath;
+		int tcpFd;
+		int tcpPort;
+		std::thread thread;
+		std::atomic<bool> running;
+		std::mutex clientsMutex;				// Guards clients against subscribers()
+		vector<Client> clients;
+		int nextClientId;
+		vector<LidarLiteRecord> pending;		// Records not yet framed, server thread only
+		chrono::steady_clock::time_point pendingSince;
+		std::atomic<unsigned long long> sent;
+		std::atomic<unsigned long long> dropped;
+
+		void loop();
+		void wake();
+		void accept(int listenFd, bool tcp);
+		void emit(size_t count);
+		bool flush(Client & client);
+		void closeClient(size_t index);
+
+		// Not copyable, owns sockets and a thread
+		LidarLiteStreamServer(const LidarLiteStreamServer &);
+		LidarLiteStreamServer & operator=(const LidarLiteStreamServer &);
+};
+
+class LidarLiteStreamClient
+{
+	public:
+		LidarLiteStreamClient();
+		~LidarLiteStreamClient();
+
+		bool connectUnix(const std::string & path);
+		bool connectTcp(const std::string & host, int port);
+		bool isConnected();
+		void close();
+
+		// Blocks for the next frame and replaces records with its records.
+		// Returns false once the connection is closed or the stream is corrupt.
+		bool readFrame(vector<LidarLiteRecord> & records, LidarLiteStreamFrameHeader * header = NULL);
+
+		int getFd();							// For poll()/select() before readFrame()
+		unsigned long long droppedRecords();	// Sum of droppedRecords over the frames read
+
+	private:
+		int fd;
+		unsigned long long dropped;
+
+		bool readFully(void * buffer, size_t length);
+
+		// Not copyable, owns fd
+		LidarLiteStreamClient(const LidarLiteStreamClient &);
+		LidarLiteStreamClient & operator=(const LidarLiteStreamClient &);
+};
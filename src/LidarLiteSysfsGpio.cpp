@@ -0,0 +1,88 @@
+/*
+LidarLiteSysfsGpio - LidarLiteModePin backed by a /sys/class/gpio edge
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+*/
+
+#include "LidarLiteSysfsGpio.hpp"
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+
+//--------------------------------------------------------------
+LidarLiteSysfsGpio::LidarLiteSysfsGpio(int gpio, const std::string & edge) {
+	fd = -1;
+
+	std::stringstream number;
+	number << gpio;
+	std::string dir = "/sys/class/gpio/gpio" + number.str();
+
+	// Already exported is fine, the write just fails with EBUSY
+	if (access(dir.c_str(), F_OK) != 0) {
+		writeFile("/sys/class/gpio/export", number.str());
+	}
+	writeFile(dir + "/direction", "in");
+	if (!writeFile(dir + "/edge", edge)) return;
+
+	fd = ::open((dir + "/value").c_str(), O_RDONLY | O_NONBLOCK);
+	if (fd > -1) clearEdge();
+}
+
+//--------------------------------------------------------------
+LidarLiteSysfsGpio::~LidarLiteSysfsGpio() {
+	if (fd > -1) ::close(fd);
+}
+
+//--------------------------------------------------------------
+bool LidarLiteSysfsGpio::isOpen() {
+	return (fd > -1);
+}
+
+/* =============================================================================
+  waitForEdge
+  sysfs reports an edge as POLLPRI on the value file. The value has to be read
+  back from offset 0 afterwards or the next poll returns immediately.
+============================================================================= */
+int LidarLiteSysfsGpio::waitForEdge(int timeoutMicros) {
+	if (fd < 0) return -1;
+
+	struct pollfd pfd;
+	pfd.fd = fd;
+	pfd.events = POLLPRI | POLLERR;
+	pfd.revents = 0;
+
+	struct timespec timeout;
+	timeout.tv_sec = timeoutMicros / 1000000;
+	timeout.tv_nsec = (long) (timeoutMicros % 1000000) * 1000;
+
+	int ready = ppoll(&pfd, 1, &timeout, NULL);
+	if (ready < 0) return -1;
+	if (ready == 0) return 0;
+
+	clearEdge();
+	return 1;
+}
+
+//--------------------------------------------------------------
+bool LidarLiteSysfsGpio::writeFile(const std::string & path, const std::string & value) {
+	int f = ::open(path.c_str(), O_WRONLY);
+	if (f < 0) return false;
+	bool ok = (::write(f, value.c_str(), value.size()) == (ssize_t) value.size());
+	::close(f);
+	return ok;
+}
+
+//--------------------------------------------------------------
+void LidarLiteSysfsGpio::clearEdge() {
+	char buf[4];
+	lseek(fd, 0, SEEK_SET);
+	if (::read(fd, buf, sizeof(buf)) < 0) {
+		// Nothing to do, the next ppoll reports the error
+	}
+}
@@ -0,0 +1,47 @@
+/*
+LidarLiteSysfsGpio - LidarLiteModePin backed by a /sys/class/gpio edge
+Created by Produce Consume Robot 2015.
+http://produceconsumerobot.com/
+
+This work is licensed under the Creative Commons
+Attribution-ShareAlike 3.0 Unported License.
+To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
+
+Exports the GPIO, configures it as an input with edge detection and waits for
+edges with ppoll() on its value file, so the waiting thread sleeps in the
+kernel until the interrupt fires.
+
+Example Usage
+------------------------------------------------------------------------------
+	// LIDAR Lite MODE pin wired to BCM GPIO 17
+	myLidarLite.setModePin(shared_ptr<LidarLiteModePin>(new LidarLiteSysfsGpio(17)));
+	myLidarLite.startContinuous(500);
+*/
+
+#pragma once
+
+#include "LidarLiteModePin.hpp"
+#include <string>
+
+class LidarLiteSysfsGpio : public LidarLiteModePin
+{
+	public:
+		// edge is "falling", "rising" or "both"
+		LidarLiteSysfsGpio(int gpio, const std::string & edge = "falling");
+		~LidarLiteSysfsGpio();
+
+		// Returns whether the GPIO value file was opened
+		bool isOpen();
+
+		int waitForEdge(int timeoutMicros);
+
+	private:
+		int fd;									// file descriptor of /sys/class/gpio/gpioN/value
+
+		bool writeFile(const std::string & path, const std::string & value);
+		void clearEdge();
+
+		// Not copyable, owns fd
+		LidarLiteSysfsGpio(const LidarLiteSysfsGpio &);
+		LidarLiteSysfsGpio & operator=(const LidarLiteSysfsGpio &);
+};
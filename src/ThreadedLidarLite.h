@@ -6,12 +6,14 @@ This work is licensed under the Creative Commons
 Attribution-ShareAlike 3.0 Unported License. 
 To view a copy of this license, visit http://creativecommons.org/licenses/by-sa/3.0/.
 
-Leverages WiringPi by drogon
 Derived from https://github.com/PulsedLight3D/LIDARLite_v2_Arduino_Library/tree/master/LIDARLite
 	
+Thin openFrameworks adapter: runs LidarLiteReader's acquisition loop on an
+ofThread. Headless programs can use LidarLiteReader directly and skip the
+openFrameworks dependency.
+
 Requirements:
-	Install wiring pi - http://wiringpi.com/
-	Add PROJECT_LDFLAGS += -lwiringPi to the PROJECT LINKER FLAGS section of config.make
+	Enable the Linux i2c-dev driver (see README.md)
 	
 See LIDAR Lite documentation for more info
 http://kb.pulsedlight3d.com/
@@ -19,27 +21,18 @@ https://github.com/PulsedLight3D/
 */
 
 #pragma once
-#include "LidarLite.hpp"
+#include "LidarLiteReader.hpp"
 #include "ofMain.h"
 
-class ThreadedLidarLite : public ofThread, public LidarLite
+class ThreadedLidarLite : public ofThread, public LidarLiteReader
 {
-    private:
-    int _distance;                          // Stores the output locally to permit thread-safe processing
-    int _signalStrength;                    // Stores the output locally to permit thread-safe processing
-    bool _newOutputAvailable;               // Tracks whether a new output is available from getOutput(); 
-    bool _readStarted;                      // Tracks whether a LidarLite distance read has been initiated 
-    unsigned int inputCount;				// debug counter
-	unsigned int outputCount;				// debug counter
-    
     public:
     ThreadedLidarLite();
     ~ThreadedLidarLite();
     void start(bool blocking = false);		// Start a thread, defaults to non-blocking to allow avoid slowing down main thread
 	void stop();							// Stop the thread
 	void threadedFunction();                // Threaded loop
-    bool startDistanceRead();               // initiates a distance and signal strength read
-    bool isOutputNew();                     // Returns whether new output data is available
-    bool getOutput(int & distance, int & signalStrength);
-   
+    
+    protected:
+    bool keepReading();                     // The loop runs as long as the ofThread does
 };
\ No newline at end of file